@@ -0,0 +1,294 @@
+/*
+    Kernel microbenchmarks
+
+    Times the innermost kernels one at a time on a single thread: triangle,
+    AABB and BVH intersection, Sobol sampling, BRDF sampling and evaluation,
+    bitmap lookups, film accumulation and camera ray generation. The rays are
+    generated from a fixed seed and can be recorded to a file and replayed,
+    so before/after numbers of an optimization use exactly the same input.
+    Usage: pt_kernelbench [--scene name] [--rays count] [--record file | --replay file] [filter]
+*/
+
+#include <pt/scene.h>
+#include <pt/camera.h>
+#include <pt/shape.h>
+#include <pt/material.h>
+#include <pt/bvh.h>
+#include <pt/vec.h>
+#include <pt/sampler.h>
+#include <pt/bitmap.h>
+#include <pt/block.h>
+#include <pt/filter.h>
+#include <pcg32.h>
+#include <chrono>
+#include <fstream>
+#include <functional>
+
+using namespace pt;
+
+struct Kernel {
+    std::string name;
+    size_t ops; // calls per run
+    std::function<float()> run; // returns a checksum so the work is not optimized away
+};
+
+static const char RayFileMagic[8] = { 'P', 'T', 'R', 'A', 'Y', 'S', '1', '\0' };
+
+// binary ray set: magic, count, then origin, direction, min and max distance per ray
+static void saveRays(const std::string& path, const std::vector<Ray>& rays) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        throw PathTracerException(("Could not write ray file \"" + path + "\"!").c_str());
+
+    uint64_t count = rays.size();
+    file.write(RayFileMagic, sizeof(RayFileMagic));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const Ray& ray : rays) {
+        float data[8] = { ray.org.x(), ray.org.y(), ray.org.z(), ray.dir.x(), ray.dir.y(), ray.dir.z(), ray.min_dis, ray.max_dis };
+        file.write(reinterpret_cast<const char*>(data), sizeof(data));
+    }
+}
+
+static std::vector<Ray> loadRays(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(RayFileMagic)];
+    uint64_t count = 0;
+    if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), RayFileMagic) ||
+        !file.read(reinterpret_cast<char*>(&count), sizeof(count)))
+        throw PathTracerException(("Invalid ray file \"" + path + "\"!").c_str());
+
+    std::vector<Ray> rays(count);
+    for (Ray& ray : rays) {
+        float data[8];
+        if (!file.read(reinterpret_cast<char*>(data), sizeof(data)))
+            throw PathTracerException(("Truncated ray file \"" + path + "\"!").c_str());
+        ray = Ray(Vector3f(data[0], data[1], data[2]), Vector3f(data[3], data[4], data[5]), data[6], data[7]);
+    }
+    return rays;
+}
+
+// half camera rays through random pixels, half rays from random points inside the scene
+static std::vector<Ray> generateRays(Scene& scene, size_t count) {
+    pcg32 rng;
+    Camera* camera = scene.getCamera();
+    Vector2i size = camera->getScreenSize();
+    const AABB& bounds = scene.getBounds();
+
+    std::vector<Ray> rays(count);
+    for (size_t i = 0; i < count; i++) {
+        if (i % 2 == 0) {
+            rays[i] = camera->sampleRay(Vector2f(rng.nextFloat() * size.x(), rng.nextFloat() * size.y()));
+            continue;
+        }
+        Vector3f t(rng.nextFloat(), rng.nextFloat(), rng.nextFloat());
+        Vector3f org = bounds.getMin() + t.cwiseProduct(bounds.getMax() - bounds.getMin());
+        float z = 1.0f - 2.0f * rng.nextFloat(), r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        float phi = 2.0f * float(M_PI) * rng.nextFloat();
+        rays[i] = Ray(org, Vector3f(r * std::cos(phi), r * std::sin(phi), z));
+    }
+    return rays;
+}
+
+// best of five runs after a warm up, in nanoseconds per call
+static double benchmark(const Kernel& kernel, float& sink) {
+    sink += kernel.run();
+    double best = std::numeric_limits<double>::infinity();
+    for (int run = 0; run < 5; run++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        sink += kernel.run();
+        auto end = std::chrono::high_resolution_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count() / kernel.ops);
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    std::string sceneName = "cornell-box";
+    size_t rayCount = 1 << 18;
+    std::string recordPath, replayPath, filter;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string token(argv[i]);
+        bool hasValue = i + 1 < argc;
+        if (token == "--scene" && hasValue)
+            sceneName = argv[++i];
+        else if (token == "--rays" && hasValue)
+            rayCount = std::max(atoi(argv[++i]), 1);
+        else if (token == "--record" && hasValue)
+            recordPath = argv[++i];
+        else if (token == "--replay" && hasValue)
+            replayPath = argv[++i];
+        else if (token[0] != '-' && filter.empty())
+            filter = token;
+        else {
+            cerr << "Usage: pt_kernelbench [--scene name] [--rays count] [--record file | --replay file] [filter]" << endl;
+            return -1;
+        }
+    }
+
+    try {
+        Scene scene;
+        scene.loadOBJ(tfm::format("./scenes/%s/%s.obj", sceneName, sceneName));
+        scene.loadXML(tfm::format("./scenes/%s/%s.xml", sceneName, sceneName));
+        scene.preprocess();
+
+        std::vector<Ray> rays = replayPath.empty() ? generateRays(scene, rayCount) : loadRays(replayPath);
+        if (!recordPath.empty())
+            saveRays(recordPath, rays);
+        size_t n = rays.size();
+
+        // inputs derived from the ray set
+        pcg32 rng;
+        std::vector<Vec3> orgs(n), invDirs(n);
+        std::vector<Intersection> hits;
+        std::vector<Vector3f> wos;
+        for (size_t i = 0; i < n; i++) {
+            orgs[i] = Vec3(rays[i].org);
+            invDirs[i] = rcp(Vec3(rays[i].dir));
+            Intersection its;
+            if (scene.rayIntersect(rays[i], its) && its.getMaterial()) {
+                hits.push_back(its);
+                wos.push_back(-rays[i].dir);
+            }
+        }
+        if (hits.empty())
+            throw PathTracerException("No ray of the set hits the scene!");
+
+        const std::vector<Triangle*>& triangles = *scene.getPrimitives();
+        std::vector<AABB> boxes(256);
+        const AABB& bounds = scene.getBounds();
+        Vector3f extent = bounds.getMax() - bounds.getMin();
+        for (AABB& box : boxes) {
+            Vector3f p0 = bounds.getMin() + Vector3f(rng.nextFloat(), rng.nextFloat(), rng.nextFloat()).cwiseProduct(extent);
+            Vector3f p1 = p0 + 0.1f * Vector3f(rng.nextFloat(), rng.nextFloat(), rng.nextFloat()).cwiseProduct(extent);
+            box = AABB(p0, p1);
+        }
+
+        BVHTree bvh(const_cast<std::vector<Triangle*>*>(&triangles));
+        bvh.build();
+
+        Vector2i screenSize = scene.getCamera()->getScreenSize();
+        SobolSampler sobol(64, screenSize);
+        sobol.startBlockSample(Vector2i(0, 0));
+
+        Bitmap bitmap(Vector2i(1024, 1024));
+        for (int y = 0; y < 1024; y++)
+            for (int x = 0; x < 1024; x++)
+                bitmap.coeffRef(y, x) = Color3f(rng.nextFloat(), rng.nextFloat(), rng.nextFloat());
+
+        ImageBlock film(screenSize, scene.getFilter());
+        ImageBlock tile(Vector2i(PT_BLOCK_SIZE), scene.getFilter());
+        film.clear();
+        tile.clear();
+
+        std::vector<Kernel> kernels = {
+            { "Triangle::intersect", n, [&] {
+                float sum = 0.0f;
+                for (size_t i = 0; i < n; i++) {
+                    Vector3f bary; float t;
+                    if (triangles[(i * 7919) % triangles.size()]->intersect(rays[i], bary, t)) sum += t;
+                }
+                return sum;
+            } },
+            { "AABB::intersect", n, [&] {
+                float sum = 0.0f;
+                for (size_t i = 0; i < n; i++)
+                    sum += boxes[i & 255].intersect(orgs[i], invDirs[i], rays[i].min_dis, rays[i].max_dis);
+                return sum;
+            } },
+            { "BVHTree::rayIntersect (closest)", n, [&] {
+                float sum = 0.0f;
+                for (size_t i = 0; i < n; i++) {
+                    Intersection its;
+                    if (bvh.rayIntersect(rays[i], its)) sum += its.p.x();
+                }
+                return sum;
+            } },
+            { "BVHTree::rayIntersect (any)", n, [&] {
+                float sum = 0.0f;
+                for (size_t i = 0; i < n; i++)
+                    sum += bvh.rayIntersect(rays[i]);
+                return sum;
+            } },
+            { "sobol::sobolSample", n * 8, [&] {
+                float sum = 0.0f;
+                for (size_t i = 0; i < n; i++)
+                    for (int d = 0; d < 8; d++)
+                        sum += sobol::sobolSample(int64_t(i), d);
+                return sum;
+            } },
+            { "SobolSampler::startPixelSample", n, [&] {
+                float sum = 0.0f;
+                for (size_t i = 0; i < n; i++) {
+                    sobol.startPixelSample(Vector2i(int(i % screenSize.x()), int(i / screenSize.x()) % screenSize.y()), int(i % 64));
+                    sum += sobol.sample1D();
+                }
+                return sum;
+            } },
+            { "Material::sampleBRDF", n, [&] {
+                float sum = 0.0f;
+                for (size_t i = 0; i < n; i++) {
+                    const Intersection& its = hits[i % hits.size()];
+                    float u0 = (i & 1023) / 1024.0f, u1 = ((i * 7) & 1023) / 1024.0f, u2 = ((i * 13) & 1023) / 1024.0f;
+                    sum += its.getMaterial()->sampleBRDF(wos[i % hits.size()], u0, Vector2f(u1, u2), its).pdf;
+                }
+                return sum;
+            } },
+            { "Material::BRDF", n, [&] {
+                float sum = 0.0f;
+                for (size_t i = 0; i < n; i++) {
+                    size_t h = i % hits.size();
+                    const Intersection& its = hits[h];
+                    sum += its.getMaterial()->BRDF(wos[h], its.n, its).x();
+                }
+                return sum;
+            } },
+            { "Bitmap::sample", n, [&] {
+                Color3f sum(0.0f);
+                for (size_t i = 0; i < n; i++)
+                    sum += bitmap.sample(Vector2f(((i * 7919) & 65535) / 65536.0f, ((i * 104729) & 65535) / 65536.0f));
+                return sum.sum();
+            } },
+            { "ImageBlock::put (sample)", n, [&] {
+                for (size_t i = 0; i < n; i++) {
+                    Vector2f pos(((i * 7) % (PT_BLOCK_SIZE * 16)) / 16.0f, ((i * 13) % (PT_BLOCK_SIZE * 16)) / 16.0f);
+                    tile.put(pos, Color3f(1.0f), 1.0f);
+                }
+                return tile.coeff(1, 1).w();
+            } },
+            { "ImageBlock::put (block merge)", 64, [&] {
+                for (int i = 0; i < 64; i++) {
+                    tile.setOffset(Vector2i((i % 8) * PT_BLOCK_SIZE, (i / 8) * PT_BLOCK_SIZE).cwiseMin(screenSize - Vector2i(PT_BLOCK_SIZE)));
+                    film.put(tile);
+                }
+                return film.coeff(1, 1).w();
+            } },
+            { "Camera::sampleRay", n, [&] {
+                float sum = 0.0f;
+                Camera* camera = scene.getCamera();
+                for (size_t i = 0; i < n; i++)
+                    sum += camera->sampleRay(Vector2f(float(i % screenSize.x()) + 0.5f, float((i / screenSize.x()) % screenSize.y()) + 0.5f)).dir.x();
+                return sum;
+            } },
+        };
+
+        cout << tfm::format("scene %s, %i rays (%s), %i hits", sceneName, n,
+            replayPath.empty() ? "generated" : "replayed from " + replayPath, hits.size()) << endl;
+        cout << tfm::format("%-36s %12s", "kernel", "ns / call") << endl;
+
+        float sink = 0.0f;
+        for (const Kernel& kernel : kernels) {
+            if (!filter.empty() && kernel.name.find(filter) == std::string::npos)
+                continue;
+            cout << tfm::format("%-36s %12.2f", kernel.name, benchmark(kernel, sink)) << endl;
+        }
+
+        // keep the results alive
+        cout << tfm::format("(checksum %.3f)", sink) << endl;
+    }
+    catch (const PathTracerException& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
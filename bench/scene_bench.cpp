@@ -0,0 +1,216 @@
+/*
+    Scene benchmark
+
+    Loads the bundled scenes and measures load time, BVH build time, the
+    throughput of primary, shadow and diffuse bounce rays and the samples per
+    second of the path tracer, written as JSON.
+    Usage: pt_bench [-t threads] [-s spp] [-r rays] [-o output.json] [scene ...]
+*/
+
+#include <pt/scene.h>
+#include <pt/camera.h>
+#include <pt/shape.h>
+#include <pt/light.h>
+#include <pt/bvh.h>
+#include <pt/tangent.h>
+#include <pt/sampler.h>
+#include <pt/integrator.h>
+#include <pt/block.h>
+#include <pt/render.h>
+#include <pcg32.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <tbb/task_scheduler_init.h>
+#include <chrono>
+#include <fstream>
+#include <functional>
+
+using namespace pt;
+
+struct ShadowQuery {
+    Vector3f p0, p1, n0, n1;
+};
+
+struct SceneResult {
+    std::string name;
+    size_t triangles;
+    Vector2i resolution;
+    double loadMs, preprocessMs, bvhBuildMs;
+    double primaryRays, shadowRays, diffuseRays; // rays per second
+    double renderMs, samples; // samples per second
+};
+
+static double milliseconds(const std::function<void()>& f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// best of three runs after a warm up, in queries per second
+static double throughput(size_t count, const std::function<void(size_t)>& query) {
+    auto run = [&] {
+        return milliseconds([&] {
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, count, 1024), [&](const tbb::blocked_range<size_t>& r) {
+                for (size_t i = r.begin(); i != r.end(); ++i)
+                    query(i);
+            });
+        });
+    };
+
+    run();
+    double best = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < 3; i++)
+        best = std::min(best, run());
+    return count / (best * 1e-3);
+}
+
+static SceneResult benchmarkScene(const std::string& name, int rays, uint32_t spp) {
+    SceneResult result;
+    result.name = name;
+
+    Scene scene;
+    std::string objPath = tfm::format("./scenes/%s/%s.obj", name, name);
+    std::string xmlPath = tfm::format("./scenes/%s/%s.xml", name, name);
+    result.loadMs = milliseconds([&] {
+        scene.loadOBJ(objPath);
+        scene.loadXML(xmlPath);
+    });
+    result.preprocessMs = milliseconds([&] { scene.preprocess(); });
+    result.triangles = scene.getPrimitives()->size();
+
+    // the scene keeps its own BVH, this one is only built for timing
+    result.bvhBuildMs = milliseconds([&] {
+        BVHTree bvh(const_cast<std::vector<Triangle*>*>(scene.getPrimitives()));
+        bvh.build();
+    });
+
+    // ray sets, generated up front so that only traversal is timed
+    Camera* camera = scene.getCamera();
+    Vector2i size = camera->getScreenSize();
+    result.resolution = size;
+    pcg32 rng;
+    std::vector<Ray> primary(rays), diffuse;
+    std::vector<ShadowQuery> shadow;
+    for (Ray& ray : primary)
+        ray = camera->sampleRay(Vector2f(rng.nextFloat() * size.x(), rng.nextFloat() * size.y()));
+
+    const std::vector<AreaLight*>& lights = scene.getLights();
+    for (const Ray& ray : primary) {
+        Intersection its;
+        if (!scene.rayIntersect(ray, its)) continue;
+
+        if (!lights.empty()) {
+            const AreaLight* light = scene.getLightSelector()->select(rng.nextFloat(), its.p, its.n);
+            LightLiSample ls = light->sampleLi(its, Vector2f(rng.nextFloat(), rng.nextFloat()));
+            shadow.push_back(ShadowQuery{ its.p, ls.p, its.n, ls.n });
+        }
+
+        Vector3f w = sampleCosineHemisphere(Vector2f(rng.nextFloat(), rng.nextFloat()));
+        diffuse.push_back(its.genRay(its.ts.toWorld(w).normalized()));
+    }
+
+    result.primaryRays = throughput(primary.size(), [&](size_t i) {
+        Intersection its;
+        scene.rayIntersect(primary[i], its);
+    });
+    result.shadowRays = shadow.empty() ? 0.0 : throughput(shadow.size(), [&](size_t i) {
+        const ShadowQuery& q = shadow[i];
+        scene.unocculded(q.p0, q.p1, q.n0, q.n1);
+    });
+    result.diffuseRays = diffuse.empty() ? 0.0 : throughput(diffuse.size(), [&](size_t i) {
+        Intersection its;
+        scene.rayIntersect(diffuse[i], its);
+    });
+
+    // full path tracer at a fixed sample count
+    PathIntegrator integrator;
+    SobolSampler sampler(spp, size);
+    ImageBlock image(size, scene.getFilter());
+    image.clear();
+    result.renderMs = milliseconds([&] { render(&scene, &sampler, &integrator, &image); });
+    result.samples = double(size.prod()) * spp / (result.renderMs * 1e-3);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int threadCount = tbb::task_scheduler_init::automatic;
+    uint32_t spp = 16;
+    int rays = 1 << 20;
+    std::string output = "pt_bench.json";
+    std::vector<std::string> scenes;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string token(argv[i]);
+        bool hasValue = i + 1 < argc;
+        if ((token == "-t" || token == "--threads") && hasValue)
+            threadCount = atoi(argv[++i]);
+        else if ((token == "-s" || token == "--spp") && hasValue)
+            spp = atoi(argv[++i]);
+        else if ((token == "-r" || token == "--rays") && hasValue)
+            rays = atoi(argv[++i]);
+        else if ((token == "-o" || token == "--output") && hasValue)
+            output = argv[++i];
+        else if (token == "bathroom" || token == "cornell-box" || token == "library" || token == "veach-mis")
+            scenes.push_back(token);
+        else {
+            cerr << "Usage: pt_bench [-t threads] [-s spp] [-r rays] [-o output.json] [scene ...]" << endl;
+            return -1;
+        }
+    }
+    if (threadCount <= 0 || spp <= 0 || rays <= 0) {
+        cerr << "Usage: pt_bench [-t threads] [-s spp] [-r rays] [-o output.json] [scene ...]" << endl;
+        return -1;
+    }
+    if (scenes.empty())
+        scenes = { "cornell-box", "veach-mis", "bathroom", "library" };
+
+    tbb::task_scheduler_init init(threadCount);
+
+    std::vector<SceneResult> results;
+    try {
+        for (const std::string& name : scenes)
+            results.push_back(benchmarkScene(name, rays, spp));
+    }
+    catch (const PathTracerException& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+
+    std::ofstream file(output);
+    if (!file) {
+        cerr << "Could not write \"" << output << "\"" << endl;
+        return 1;
+    }
+    file << "{\n";
+    file << tfm::format("  \"threads\": %i,\n", threadCount == tbb::task_scheduler_init::automatic ?
+        tbb::task_scheduler_init::default_num_threads() : threadCount);
+    file << tfm::format("  \"spp\": %i,\n", spp);
+    file << tfm::format("  \"rays\": %i,\n", rays);
+    file << "  \"scenes\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const SceneResult& r = results[i];
+        file << "    {\n";
+        file << tfm::format("      \"name\": \"%s\",\n", r.name);
+        file << tfm::format("      \"triangles\": %i,\n", r.triangles);
+        file << tfm::format("      \"resolution\": [%i, %i],\n", r.resolution.x(), r.resolution.y());
+        file << tfm::format("      \"load_ms\": %.3f,\n", r.loadMs);
+        file << tfm::format("      \"preprocess_ms\": %.3f,\n", r.preprocessMs);
+        file << tfm::format("      \"bvh_build_ms\": %.3f,\n", r.bvhBuildMs);
+        file << tfm::format("      \"primary_rays_per_sec\": %.0f,\n", r.primaryRays);
+        file << tfm::format("      \"shadow_rays_per_sec\": %.0f,\n", r.shadowRays);
+        file << tfm::format("      \"diffuse_rays_per_sec\": %.0f,\n", r.diffuseRays);
+        file << tfm::format("      \"render_ms\": %.3f,\n", r.renderMs);
+        file << tfm::format("      \"samples_per_sec\": %.0f\n", r.samples);
+        file << (i + 1 < results.size() ? "    },\n" : "    }\n");
+    }
+    file << "  ]\n}\n";
+
+    cout << tfm::format("%-12s %12s %12s %12s %12s", "scene", "primary", "shadow", "diffuse", "samples") << endl;
+    for (const SceneResult& r : results) {
+        cout << tfm::format("%-12s %11.2fM %11.2fM %11.2fM %11.2fM", r.name,
+            r.primaryRays * 1e-6, r.shadowRays * 1e-6, r.diffuseRays * 1e-6, r.samples * 1e-6) << endl;
+    }
+    cout << "Results written to \"" << output << "\"" << endl;
+    return 0;
+}
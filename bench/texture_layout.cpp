@@ -0,0 +1,86 @@
+/*
+    Texture layout microbenchmark
+
+    Compares bilinear lookups in row-major and tiled texel layouts for a few
+    access patterns. Usage: pt_texbench [texture size] [lookups per pattern]
+*/
+
+#include <pt/texture.h>
+#include <pcg32.h>
+#include <chrono>
+#include <functional>
+
+using namespace pt;
+
+struct Pattern {
+    std::string name;
+    std::function<Vector2f(int)> uv;
+};
+
+static double benchmark(const Texture& texture, const std::vector<Vector2f>& uvs, Color3f& sum) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const Vector2f& uv : uvs)
+        sum += texture.sample(uv);
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / uvs.size();
+}
+
+int main(int argc, char** argv) {
+    int size = argc > 1 ? atoi(argv[1]) : 2048;
+    int lookups = argc > 2 ? atoi(argv[2]) : 1 << 23;
+    if (size <= 0 || lookups <= 0) {
+        cerr << "Usage: pt_texbench [texture size] [lookups per pattern]" << endl;
+        return -1;
+    }
+
+    // procedural noise texture
+    pcg32 rng;
+    std::vector<uint8_t> rgb8(3 * size_t(size) * size);
+    for (uint8_t& value : rgb8)
+        value = uint8_t(rng.nextUInt(256));
+
+    Texture rowMajor("row major"), tiled("tiled");
+    rowMajor.setData(size, size, rgb8.data(), Texture::Layout::RowMajor);
+    tiled.setData(size, size, rgb8.data(), Texture::Layout::Tiled);
+
+    // walks advance by about one texel per lookup and wrap around the texture
+    float step = 1.0f / size;
+    int rowLength = std::max(lookups / size, 1);
+    float cosTheta = std::cos(0.5f), sinTheta = std::sin(0.5f);
+    std::vector<Pattern> patterns = {
+        { "scanline", [&](int i) { int j = i % (size * size); return Vector2f((j % size) * step, (j / size) * step); } },
+        { "column",   [&](int i) { int j = i % (size * size); return Vector2f((j / size) * step, (j % size) * step); } },
+        { "rotated",  [&](int i) {
+            float s = (i % rowLength) * step, t = (i / rowLength) * step;
+            float u = 0.5f + cosTheta * s - sinTheta * t, v = sinTheta * s + cosTheta * t;
+            return Vector2f(u - std::floor(u), v - std::floor(v));
+        } },
+        { "random",   [&](int i) { return Vector2f(rng.nextFloat(), rng.nextFloat()); } },
+    };
+
+    cout << tfm::format("texture %ix%i, %i lookups per pattern", size, size, lookups) << endl;
+    cout << tfm::format("%-10s %16s %16s %10s", "pattern", "row major (ns)", "tiled (ns)", "speedup") << endl;
+
+    Color3f sum(0.0f);
+    std::vector<Vector2f> uvs(lookups);
+    for (const Pattern& pattern : patterns) {
+        for (int i = 0; i < lookups; i++)
+            uvs[i] = pattern.uv(i);
+
+        // warm up, then take the best of three runs
+        benchmark(rowMajor, uvs, sum);
+        benchmark(tiled, uvs, sum);
+        double rowMajorTime = std::numeric_limits<double>::infinity();
+        double tiledTime = std::numeric_limits<double>::infinity();
+        for (int run = 0; run < 3; run++) {
+            rowMajorTime = std::min(rowMajorTime, benchmark(rowMajor, uvs, sum));
+            tiledTime = std::min(tiledTime, benchmark(tiled, uvs, sum));
+        }
+
+        cout << tfm::format("%-10s %16.2f %16.2f %9.2fx", pattern.name, rowMajorTime, tiledTime, rowMajorTime / tiledTime) << endl;
+    }
+
+    // keep the lookups alive
+    cout << tfm::format("(checksum %.3f)", sum.sum()) << endl;
+    return 0;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <pt/common.h>
+#include <pt/vec.h>
 
 namespace pt {
 
@@ -55,6 +56,10 @@ public:
 		return r += b;
 	}
 
+	// Corners of AABB
+	inline const Vector3f& getMin() const { return m_min; }
+	inline const Vector3f& getMax() const { return m_max; }
+
 	// Check if AABB is empty
 	inline bool empty() const { return m_max.x() < m_min.x(); }
 
@@ -130,6 +135,15 @@ public:
 	// Ray-AABB intersection
 	bool intersect(const Ray& ray) const;
 
+	// Slab test with the reciprocal ray direction precomputed by the caller
+	inline bool intersect(const Vec3& org, const Vec3& inv_dir, float min_dis, float max_dis) const {
+		Vec3 t0 = (Vec3(m_min) - org) * inv_dir;
+		Vec3 t1 = (Vec3(m_max) - org) * inv_dir;
+		float tnear = std::max(hmax(min(t0, t1)), min_dis);
+		float tfar = std::min(hmin(max(t0, t1)), max_dis);
+		return tnear <= tfar;
+	}
+
 	std::string toString() const {
 		return tfm::format(
 			"AABB[\n"
@@ -45,7 +45,7 @@ public:
 };
 
 
-class BDPTIntegrator : public Integrator {
+class BDPTIntegrator final : public Integrator {
 public:
 	static constexpr int MaxDepth = 5;
 
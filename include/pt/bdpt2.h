@@ -23,7 +23,7 @@ struct BDPTVertex {
 };
 
 
-class BDPTIntegrator2 : public Integrator {
+class BDPTIntegrator2 final : public Integrator {
 public:
 	static constexpr int MaxDepth = 5;
 
@@ -12,7 +12,10 @@
 
 #include <pt/color.h>
 #include <pt/vector.h>
-#include <tbb/mutex.h>
+#include <tbb/spin_mutex.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <memory>
+#include <atomic>
 
 #define PT_BLOCK_SIZE 32 /* Block size used for parallelization */
 
@@ -31,6 +34,11 @@ namespace pt {
  * this region. For that reason, this class also stores information about
  * a small border region around the rectangle, whose size depends on the
  * properties of the reconstruction filter.
+ *
+ * Concurrent writers (tile merges, splats, GUI snapshots) only lock the
+ * stripes of LockRows rows they touch, so tiles in different rows are
+ * merged in parallel and the overlapping filter borders of neighboring
+ * tiles are serialized by the stripe they share.
  */
 class ImageBlock : public Eigen::Array<Color4f, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> {
 public:
@@ -79,7 +87,10 @@ public:
     /// Record a sample with the given position and radiance value
     void put(const Vector2f & globalPos, const Color3f &value, float weight);
 
-    /// Record a splat at the given position (used by bdpt)
+    /// Record a sample in one pixel only (filter importance sampling)
+    void putPixel(const Vector2i & globalPixel, const Color3f &value, float weight = 1.0f);
+
+    /// Record a splat at the given position (used by bdpt), locks the rows it touches
     void addSplat(const Vector2f & globalPos, const Vector3f &value);
 
     /// Record a sample at the given position (used by bdpt)
@@ -88,16 +99,19 @@ public:
     /**
      * \brief Merge another image block into this one
      *
-     * During the merge operation, this function locks 
-     * the destination block using a mutex.
+     * During the merge operation, this function locks the row
+     * stripes of the destination block it writes to, one at a time.
      */
     void put(ImageBlock &b);
 
-    /// Lock the image block (using an internal mutex)
-    inline void lock() const { m_mutex.lock(); }
+    /// Copy all pixels (border included, row major) locking one stripe at a time
+    void snapshot(std::vector<Color4f>& pixels) const;
+
+    /// Lock the whole image block (all row stripes)
+    void lock() const;
     
     /// Unlock the image block
-    inline void unlock() const { m_mutex.unlock(); }
+    void unlock() const;
 
     /// Return a human-readable string summary
     std::string toString() const;
@@ -106,57 +120,176 @@ protected:
     Vector2i m_size;
     int m_borderSize = 0;
 
+    static constexpr int LockRows = 8;       // rows per lock stripe
+    static constexpr int MaxFilterWidth = 32; // pixels covered by one sample in x or y
+
+    // lock the stripes covering rows [first, last]
+    void lockRows(int first, int last) const;
+    void unlockRows(int first, int last) const;
+
+    // put() restricted to the storage rows [firstRow, lastRow], the caller holds their stripes
+    void put(const Vector2f& globalPos, const Color3f& value, float weight, int firstRow, int lastRow);
+
+    // storage rows [first, last] touched by a sample, false if it misses the block
+    bool footprintRows(const Vector2f& globalPos, int& first, int& last) const;
+
+    friend class SplatBuffer;
+
     float* m_filter = nullptr;
     float m_filterRadius = 0.0f;
-    float* m_weightsX = nullptr;
-    float* m_weightsY = nullptr;
     float m_lookupFactor = 0.0f;
 
-    mutable tbb::mutex m_mutex;
+    std::unique_ptr<tbb::spin_mutex[]> m_rowLocks;
+    int m_rowLockCount = 0;
+};
+
+/**
+ * \brief Per-thread splat queues in front of a shared ImageBlock
+ *
+ * Splats (light tracing, BDPT t = 1 connections) land anywhere on the screen,
+ * so they cannot go into the block being rendered. Instead of locking the
+ * full-screen block for every splat, each thread appends to its own queue and
+ * merges it into the target every BatchSize splats. A merge sorts the queue by
+ * row and takes every row stripe lock once for all splats touching it. The render
+ * loop calls flush() at the end of every block, so the target (and the GUI
+ * preview) is complete once a pass is done.
+ */
+class SplatBuffer {
+public:
+    static constexpr size_t BatchSize = 1024;
+
+    SplatBuffer(ImageBlock* target = nullptr) : m_target(target) { }
+
+    void setTarget(ImageBlock* target) { m_target = target; }
+
+    ImageBlock* getTarget() const { return m_target; }
+
+    /// Queue a splat, thread-safe
+    inline void add(const Vector2f& globalPos, const Vector3f& value) const {
+        auto& queue = m_queues.local();
+        queue.push_back(Splat{ globalPos, value });
+        if (queue.size() >= BatchSize) flush(queue);
+    }
+
+    /// Merge the queue of the calling thread into the target
+    void flush() const {
+        if (m_target) flush(m_queues.local());
+    }
+
+private:
+    struct Splat {
+        Vector2f pos;
+        Vector3f value;
+        int firstRow = 0, lastRow = 0; // footprint in the target, set by flush()
+    };
+
+    void flush(std::vector<Splat>& queue) const;
+
+    ImageBlock* m_target;
+    mutable tbb::enumerable_thread_specific<std::vector<Splat>> m_queues;
 };
 
 /**
- * \brief Spiraling block generator
+ * \brief Block generator with a precomputed block order
  *
  * This class can be used to chop up an image into many small
- * rectangular blocks suitable for parallel rendering. The blocks
- * are ordered in spiraling pattern so that the center is
- * rendered first.
+ * rectangular blocks suitable for parallel rendering. The order of
+ * the blocks is computed once (a spiral so that the center is rendered
+ * first, a Hilbert curve for coherence between consecutive blocks, or
+ * a caller provided priority), and blocks are handed out through an
+ * atomic counter.
  */
 class BlockGenerator {
 public:
+    enum class Order { Spiral, Hilbert };
+
     /**
      * \brief Create a block generator with
      * \param size
      *      Size of the image that should be split into blocks
      * \param blockSize
      *      Maximum size of the individual blocks
+     * \param order
+     *      Order in which the blocks are handed out
      */
-    BlockGenerator(const Vector2i &size, int blockSize);
-    
+    BlockGenerator(const Vector2i &size, int blockSize, Order order = Order::Spiral);
+
+    /**
+     * \brief Reorder the blocks by decreasing priority (one value per
+     * block, indexed by blockY * blockCountX + blockX), ties keep the
+     * current order. Must be called before rendering starts.
+     */
+    void setPriority(const std::vector<float>& priority);
+
     /**
      * \brief Return the next block to be rendered
      *
-     * This function is thread-safe
+     * This function is thread-safe and lock-free
      *
      * \return \c false if there were no more blocks
      */
     bool next(ImageBlock &block);
 
+    /// Like \ref next(), but only return the offset and size of the block
+    bool next(Vector2i &offset, Vector2i &size);
+
     /// Return the total number of blocks
-    int getBlockCount() const { return m_blocksLeft; }
+    int getBlockCount() const { return int(m_order.size()); }
+
+    /// Return the number of blocks in x and y
+    const Vector2i& getBlockCounts() const { return m_numBlocks; }
 protected:
     enum EDirection { ERight = 0, EDown, ELeft, EUp };
 
-    Vector2i m_block;
+    void computeSpiralOrder();
+    void computeHilbertOrder();
+
     Vector2i m_numBlocks;
     Vector2i m_size;
     int m_blockSize;
-    int m_numSteps;
-    int m_blocksLeft;
-    int m_stepsLeft;
-    int m_direction;
-    tbb::mutex m_mutex;
+    std::vector<int> m_order; // block indices (y * m_numBlocks.x() + x)
+    std::atomic<int> m_next{ 0 };
+};
+
+/**
+ * \brief Work queue balanced by the measured cost of every block
+ *
+ * Blocks predicted to be much more expensive than an average work item
+ * are split into quadrants (down to MinBlockSize pixels), runs of cheap
+ * blocks that are neighbours along a Hilbert curve are merged into a
+ * single item, and the items are handed out longest first so that no
+ * expensive block is left for the end of the frame.
+ */
+class TileScheduler {
+public:
+    static constexpr int MinBlockSize = 8;
+    static constexpr int ItemsPerThread = 8; // granularity the partition aims for
+
+    struct WorkItem {
+        std::vector<std::pair<Vector2i, Vector2i>> blocks; // offset, size
+        float cost = 0.0f;
+    };
+
+    /**
+     * \param cost
+     *      Predicted cost of every block of a BlockGenerator with the same
+     *      size and block size (indexed by blockY * blockCountX + blockX)
+     * \param threadCount
+     *      Number of threads that render the items
+     */
+    TileScheduler(const Vector2i &size, int blockSize, const std::vector<float>& cost, int threadCount);
+
+    /// Claim the next work item, thread-safe and lock-free. Returns nullptr when all items are taken
+    const WorkItem* next();
+
+    int getItemCount() const { return int(m_items.size()); }
+
+    std::string toString() const;
+protected:
+    void split(const Vector2i &offset, const Vector2i &size, float cost, float target);
+
+    std::vector<WorkItem> m_items;
+    std::atomic<int> m_next{ 0 };
 };
 
 }
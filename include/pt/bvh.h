@@ -6,10 +6,13 @@
 
 namespace pt {
 
-class BVHTree : public Accel {
+class BVHTree final : public Accel {
 public:
 	friend class BVHTreeBuilder;
 
+	// traversal stack kept on the C stack, deeper trees fall back to the heap
+	static constexpr size_t StackSize = 64;
+
 	struct Node {
 		AABB aabb;
 		size_t first_id, prim_count;
@@ -55,8 +58,13 @@ public:
 	std::string toString() const;
 
 private:
+	// copy the leaf triangles into m_leaf_tris and compute the tree depth
+	void packLeaves();
+
 	std::vector<Node> m_nodes;
 	std::vector<size_t> m_prim_ids;
+	std::vector<float> m_leaf_tris[9]; // SoA v0, edge1, edge2 (x, y, z each) in m_prim_ids order
+	size_t m_depth = 0;
 };
 
 
@@ -32,6 +32,9 @@ public:
 
 	Ray sampleRay(const Vector2f screen_pos);
 
+	// camera ray with differentials for one pixel offset in x and y
+	RayDifferential sampleRayDifferential(const Vector2f screen_pos);
+
 	std::optional<Vector2f> project(const Vector3f& p);
 
 	Vector3f Le(const Vector3f& w);
@@ -13,6 +13,7 @@
 #include <vector>
 
 #include <pt/vector.h>
+#include <pt/fastmath.h>
 #include <tinyformat.h>
 
 
@@ -46,6 +47,7 @@ struct Color3f;
 struct Color4f;
 class AABB;
 class Ray;
+class RayDifferential;
 class Accel;
 class Bitmap;
 class BlockGenerator;
@@ -62,8 +64,13 @@ class Transform;
 class Triangle;
 class AreaLight;
 class Filter;
+class FilterSampler;
 class TangentSpace;
+class Texture;
+class LightSelector;
 class UniformLightSelector;
+class LightCacheSelector;
+class CostHeatmap;
 
 
 /// Import cout, cerr, endl for debugging purposes
@@ -99,16 +106,46 @@ inline float absDot(const Vector3f& a, const Vector3f& b) {
 
 inline Vector3f sampleCosineHemisphere(const Vector2f& u) {
 	float su0 = std::sqrt(u.x());
-	float phi = 2.0f * M_PI * u.y();
-	return Vector3f(su0 * std::cos(phi), su0 * std::sin(phi), std::sqrt(1.0f - u.x()));
+	float sin_phi, cos_phi;
+	fastSinCos(float(2.0f * M_PI) * u.y(), sin_phi, cos_phi);
+	return Vector3f(su0 * cos_phi, su0 * sin_phi, std::sqrt(1.0f - u.x()));
 }
 
 
 inline Vector3f samplePhongSpecularLobe(const Vector2f& u, float s) {
-	float cos_theta = std::powf(u.x(), 1.0f / (s + 1.0f));
+	float cos_theta = std::min(fastPow(u.x(), 1.0f / (s + 1.0f)), 1.0f);
 	float sin_theta = std::sqrt(1.0f - cos_theta * cos_theta);
-	float phi = 2.0f * M_PI * u.y();
-	return Vector3f(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta);
+	float sin_phi, cos_phi;
+	fastSinCos(float(2.0f * M_PI) * u.y(), sin_phi, cos_phi);
+	return Vector3f(sin_theta * cos_phi, sin_theta * sin_phi, cos_theta);
+}
+
+
+// interleave the bits of x and y (x in the even bits)
+inline uint64_t encodeMorton2(uint32_t x, uint32_t y) {
+	auto spread = [](uint64_t v) {
+		v = (v | (v << 16)) & 0x0000ffff0000ffff;
+		v = (v | (v << 8)) & 0x00ff00ff00ff00ff;
+		v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0f;
+		v = (v | (v << 2)) & 0x3333333333333333;
+		v = (v | (v << 1)) & 0x5555555555555555;
+		return v;
+	};
+	return (spread(y) << 1) | spread(x);
+}
+
+inline void decodeMorton2(uint64_t code, uint32_t& x, uint32_t& y) {
+	auto compact = [](uint64_t v) {
+		v &= 0x5555555555555555;
+		v = (v | (v >> 1)) & 0x3333333333333333;
+		v = (v | (v >> 2)) & 0x0f0f0f0f0f0f0f0f;
+		v = (v | (v >> 4)) & 0x00ff00ff00ff00ff;
+		v = (v | (v >> 8)) & 0x0000ffff0000ffff;
+		v = (v | (v >> 16)) & 0x00000000ffffffff;
+		return uint32_t(v);
+	};
+	x = compact(code);
+	y = compact(code >> 1);
 }
 
 
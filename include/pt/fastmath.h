@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * \brief Branch-light scalar approximations of sin/cos/exp/log/pow
+ *
+ * Cephes single precision polynomials (errors of a few ulp) without the
+ * special case handling of the C library. Meant for the sampling routines,
+ * arguments are expected to be finite.
+ */
+
+namespace pt {
+
+/// sin and cos of x, |x| < 8192
+inline void fastSinCos(float x, float& s, float& c) {
+    float sign = 1.0f;
+    if (x < 0.0f) { x = -x; sign = -1.0f; }
+
+    // reduce to [-pi/4, pi/4] by octant
+    int j = int(x * 1.27323954473516f); // 4 / pi
+    j = (j + 1) & ~1;
+    float y = float(j);
+    float z = ((x - y * 0.78515625f) - y * 2.4187564849853515625e-4f) - y * 3.77489497744594108e-8f;
+    float zz = z * z;
+
+    float sinz = ((-1.9515295891e-4f * zz + 8.3321608736e-3f) * zz - 1.6666654611e-1f) * zz * z + z;
+    float cosz = ((2.443315711809948e-5f * zz - 1.388731625493765e-3f) * zz + 4.166664568298827e-2f) * zz * zz - 0.5f * zz + 1.0f;
+
+    switch (j & 7) {
+    case 0: s = sinz; c = cosz; break;
+    case 2: s = cosz; c = -sinz; break;
+    case 4: s = -sinz; c = -cosz; break;
+    default: s = -cosz; c = sinz; break; // 6
+    }
+    s *= sign;
+}
+
+inline float fastExp(float x) {
+    x = std::min(std::max(x, -87.3365f), 88.3762f);
+
+    // x = g + n * ln2
+    float n = std::floor(x * 1.44269504f + 0.5f);
+    float g = (x - n * 0.693359375f) + n * 2.12194440e-4f;
+
+    float y = ((((1.9875691500e-4f * g + 1.3981999507e-3f) * g + 8.3334519073e-3f) * g
+        + 4.1665795894e-2f) * g + 1.6666665459e-1f) * g + 5.0000001201e-1f;
+    y = y * g * g + g + 1.0f;
+
+    uint32_t bits = uint32_t(int(n) + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(float));
+    return y * scale;
+}
+
+/// natural logarithm, x > 0 and normal
+inline float fastLog(float x) {
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(float));
+    float e = float(int(bits >> 23) - 127);
+    bits = (bits & 0x007fffffu) | 0x3f800000u;
+    float m;
+    std::memcpy(&m, &bits, sizeof(float));
+
+    // m in [sqrt(0.5), sqrt(2))
+    if (m > 1.41421356f) { m *= 0.5f; e += 1.0f; }
+    float f = m - 1.0f;
+    float z = f * f;
+
+    float y = ((((((((7.0376836292e-2f * f - 1.1514610310e-1f) * f + 1.1676998740e-1f) * f
+        - 1.2420140846e-1f) * f + 1.4249322787e-1f) * f - 1.6668057665e-1f) * f
+        + 2.0000714765e-1f) * f - 2.4999993993e-1f) * f + 3.3333331174e-1f) * f * z;
+    y += e * -2.12194440e-4f - 0.5f * z;
+    return f + y + e * 0.693359375f;
+}
+
+/// x^y for x >= 0
+inline float fastPow(float x, float y) {
+    if (x <= 0.0f) return y == 0.0f ? 1.0f : 0.0f;
+    return fastExp(y * fastLog(x));
+}
+
+}
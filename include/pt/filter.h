@@ -49,4 +49,64 @@ protected:
     float m_stddev;
 };
 
+
+
+/**
+ * \brief Importance sampling of a separable, non-negative reconstruction filter
+ *
+ * The 1D profile is tabulated on [0, radius] and its CDF is inverted, one
+ * offset is drawn per axis. With filter importance sampling a camera sample
+ * is placed at that offset from the pixel center and written to its own
+ * pixel with weight 1, instead of being splatted into the neighbors with the
+ * filter weights.
+ */
+class FilterSampler {
+public:
+    static constexpr int Resolution = 64;
+
+    FilterSampler(const Filter* filter) : m_radius(filter->getRadius()) {
+        m_cdf[0] = 0.0f;
+        for (int i = 0; i < Resolution; ++i) {
+            float x = (i + 0.5f) * m_radius / Resolution;
+            m_cdf[i + 1] = m_cdf[i] + std::max(filter->eval(x), 0.0f);
+        }
+        if (!(m_cdf[Resolution] > 0.0f))
+            throw PathTracerException("Cannot importance sample a filter without positive weights!");
+        for (int i = 1; i <= Resolution; ++i)
+            m_cdf[i] /= m_cdf[Resolution];
+    }
+
+    // Offset from the pixel center in [-radius, radius]^2
+    Vector2f sample(const Vector2f& u) const {
+        return Vector2f(sample1D(u.x()), sample1D(u.y()));
+    }
+
+    std::string toString() const {
+        return tfm::format(
+            "FilterSampler[\n"
+            "  radius = %f,\n"
+            "  resolution = %i\n"
+            "]",
+            m_radius,
+            Resolution
+        );
+    }
+
+private:
+    float sample1D(float u) const {
+        // the first half of [0, 1) picks the negative side
+        float sign = u < 0.5f ? -1.0f : 1.0f;
+        u = std::min(u < 0.5f ? 2.0f * u : 2.0f * u - 1.0f, 0x1.fffffep-1f);
+
+        int bin = int(std::upper_bound(m_cdf, m_cdf + Resolution + 1, u) - m_cdf) - 1;
+        bin = std::clamp(bin, 0, Resolution - 1);
+        float width = m_cdf[bin + 1] - m_cdf[bin];
+        float t = width > 0.0f ? (u - m_cdf[bin]) / width : 0.5f;
+        return sign * (bin + t) * m_radius / Resolution;
+    }
+
+    float m_radius;
+    float m_cdf[Resolution + 1];
+};
+
 }
\ No newline at end of file
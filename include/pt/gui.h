@@ -1,6 +1,7 @@
 #pragma once
 
 #include <pt/common.h>
+#include <pt/color.h>
 #include <nanogui/screen.h>
 
 namespace pt {
@@ -22,6 +23,10 @@ private:
     nanogui::ref<nanogui::Texture> m_splatTexture;
     nanogui::ref<nanogui::RenderPass> m_renderPass;
 
+    // copies of the films taken without blocking the render threads
+    std::vector<Color4f> m_samplePixels;
+    std::vector<Color4f> m_splatPixels;
+
     float m_tonemapScale = 1.0f;
     float m_splatScale = 1.0f;
 };
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <pt/common.h>
+#include <tbb/concurrent_vector.h>
+
+namespace pt {
+
+/**
+ * \brief Render time per block (and optionally per pixel) of one frame
+ *
+ * Blocks never overlap, so every pixel is written by a single thread and
+ * the per-pixel times need no locking. Without per-pixel timing the time of
+ * a block is spread evenly over its pixels. \ref save() writes a heatmap as
+ * EXR (seconds per pixel) and PNG (log scale false color) and a CSV file
+ * with one line per block.
+ */
+class CostHeatmap {
+public:
+    CostHeatmap(const Vector2i& size, bool perPixel = false);
+
+    bool isPerPixel() const { return m_perPixel; }
+
+    void clear();
+
+    /// Record the time of one pixel (only used with per-pixel timing)
+    void addPixel(const Vector2i& pixel, float seconds) {
+        m_pixels[size_t(pixel.y()) * m_size.x() + pixel.x()] += seconds;
+    }
+
+    /// Record the time of a block, thread-safe
+    void addBlock(const Vector2i& offset, const Vector2i& size, float seconds);
+
+    /// Write <prefix>.exr, <prefix>.png and <prefix>.csv
+    void save(const std::string& prefix) const;
+
+    std::string toString() const;
+
+private:
+    struct BlockRecord {
+        Vector2i offset, size;
+        float seconds;
+        int thread;
+    };
+
+    Vector2i m_size;
+    bool m_perPixel;
+    std::vector<float> m_pixels;
+    tbb::concurrent_vector<BlockRecord> m_blocks;
+};
+
+}
@@ -1,24 +1,60 @@
 #pragma once
 
 #include <pt/common.h>
+#include <pt/block.h>
 
 namespace pt {
 
 struct LightLiSample;
+class BSDF;
+
+/**
+ * \brief Weighted reservoir holding one sample out of a stream of candidates
+ *
+ * A single uniform number is rescaled after every update, so the whole
+ * stream consumes only one sampler dimension.
+ */
+template <typename Sample>
+struct Reservoir {
+	Sample sample;
+	float weightSum = 0.0f;
+	int count = 0;
+
+	bool update(const Sample& s, float weight, float& u) {
+		count++;
+		if (weight <= 0.0f) return false;
+		weightSum += weight;
+		float p = weight / weightSum;
+		if (u < p) {
+			sample = s;
+			u = std::min(u / p, 0x1.fffffep-1f);
+			return true;
+		}
+		u = std::min((u - p) / (1.0f - p), 0x1.fffffep-1f);
+		return false;
+	}
+
+	bool empty() const { return weightSum == 0.0f; }
+};
 
 class Integrator {
 public:
 	virtual Vector3f Li(Scene* scene, Sampler* sampler, const Vector2f& pixelSample) = 0;
 
-	void setSplatBlock(ImageBlock* block) { m_splatBlock = block; }
+	void setSplatBlock(ImageBlock* block) { m_splats.setTarget(block); }
+
+	ImageBlock* getSplatBlock() const { return m_splats.getTarget(); }
+
+	// merge the splats queued by the calling thread, called at the end of every block
+	void flushSplats() const { m_splats.flush(); }
 
 	virtual std::string toString() const = 0;
 
 protected:
-	ImageBlock* m_splatBlock = nullptr;
+	SplatBuffer m_splats;
 };
 
-class GeometryIntegrator : public Integrator {
+class GeometryIntegrator final : public Integrator {
 public:
 	Vector3f Li(Scene* scene, Sampler* sampler, const Vector2f& pixelSample);
 
@@ -27,7 +63,7 @@ public:
 	}
 };
 
-class BaseColorIntegrator : public Integrator {
+class BaseColorIntegrator final : public Integrator {
 public:
 	Vector3f Li(Scene* scene, Sampler* sampler, const Vector2f& pixelSample);
 
@@ -36,17 +72,36 @@ public:
 	}
 };
 
-class PathIntegrator : public Integrator {
+class PathIntegrator final : public Integrator {
 public:
-	Vector3f Li(Scene* scene, Sampler* sampler, const Vector2f& pixelSample);
+	// risCandidates > 1 enables resampled importance sampling of direct lighting
+	PathIntegrator(int risCandidates = 1) : m_risCandidates(std::max(risCandidates, 1)) { }
+
+	Vector3f Li(Scene* scene, Sampler* sampler, const Vector2f& pixelSample) { return Li<Sampler>(scene, sampler, pixelSample); }
+
+	// with a concrete sampler type the sample generation is inlined into the path loop,
+	// instantiated for Sampler, IndependentSampler and SobolSampler
+	template <typename SamplerT>
+	Vector3f Li(Scene* scene, SamplerT* sampler, const Vector2f& pixelSample);
 
 	std::string toString() const {
-		return tfm::format("PathIntegrator[]");
+		return tfm::format(
+			"PathIntegrator[\n"
+			"  risCandidates = %i\n"
+			"]",
+			m_risCandidates
+		);
 	}
 
 private:
-	Vector3f sampleLd(Scene* scene, Sampler* sampler, const Intersection& its, const Vector3f& wo) const;
+	template <typename SamplerT>
+	Vector3f sampleLd(Scene* scene, SamplerT* sampler, const Intersection& its, const BSDF& bsdf) const;
+
+	// generate M light candidates, resample one by unshadowed contribution and trace one shadow ray
+	template <typename SamplerT>
+	Vector3f sampleLdRIS(Scene* scene, SamplerT* sampler, const Intersection& its, const BSDF& bsdf) const;
 
+	int m_risCandidates;
 };
 
 }
\ No newline at end of file
@@ -24,7 +24,10 @@ struct LightLeSample {
 
 class AreaLight {
 public:
-	AreaLight(Triangle* shape, const Vector3f& lemit);
+	AreaLight(Triangle* shape, const Vector3f& lemit, uint32_t id = 0);
+
+	// index of this light in the scene light list
+	uint32_t getId() const { return m_id; }
 
 	// surface normal, ray direction
 	Vector3f L(const Vector3f& n, const Vector3f& w) const;
@@ -47,31 +50,61 @@ private:
 	Triangle* m_shape;
 	Vector3f m_lemit;
 	float m_area;
+	uint32_t m_id;
 
 };
 
 
-class UniformLightSelector {
+/**
+ * \brief Chooses one of the scene lights for next event estimation
+ *
+ * The position dependent overloads receive the shading point and normal,
+ * the default implementation ignores them.
+ */
+class LightSelector {
 public:
-	UniformLightSelector(std::vector<AreaLight*>* lights) : m_lights(lights) { }
+	LightSelector(std::vector<AreaLight*>* lights) : m_lights(lights) { }
+
+	virtual ~LightSelector() { }
+
+	virtual AreaLight* select(float u) const = 0;
+
+	virtual float pdf(const AreaLight* light) const = 0;
+
+	virtual AreaLight* select(float u, const Vector3f& p, const Vector3f& n) const { return select(u); }
+
+	virtual float pdf(const AreaLight* light, const Vector3f& p, const Vector3f& n) const { return pdf(light); }
+
+	// report the unoccluded contribution of a light seen from (p, n)
+	virtual void record(const AreaLight* light, const Vector3f& p, const Vector3f& n, float contribution) { }
+
+	virtual std::string toString() const = 0;
+
+protected:
+	std::vector<AreaLight*>* m_lights;
+};
+
+
+class UniformLightSelector : public LightSelector {
+public:
+	UniformLightSelector(std::vector<AreaLight*>* lights) : LightSelector(lights) { }
+
+	using LightSelector::select;
+	using LightSelector::pdf;
 
 	AreaLight* select(float u) const {
-		return m_lights->at(static_cast<int>(u * m_lights->size()));
+		return m_lights->at(std::min(static_cast<size_t>(u * m_lights->size()), m_lights->size() - 1));
 	}
 
 	float pdf(const AreaLight* light) const {
 		return 1.0f / m_lights->size();
 	}
 
-	std::string UniformLightSelector::toString() const {
+	std::string toString() const {
 		return tfm::format(
 			"UniformLightSelector[]"
 		);
 	}
-
-private:
-	std::vector<AreaLight*>* m_lights;
-
 };
 
 }
\ No newline at end of file
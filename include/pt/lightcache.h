@@ -0,0 +1,75 @@
+#pragma once
+
+#include <pt/common.h>
+#include <pt/aabb.h>
+#include <pt/light.h>
+#include <tbb/spin_mutex.h>
+#include <array>
+
+namespace pt {
+
+/**
+ * \brief Light selector guided by a spatial hash grid learned while rendering
+ *
+ * Each grid cell (keyed by position and dominant normal direction) keeps the
+ * few lights that delivered the most unoccluded radiance to shading points
+ * inside it. Selection is a defensive mixture of the uniform distribution and
+ * the learned one, so every light keeps a non-zero probability.
+ *
+ * The cache learns while \ref isLearning() is true (selection is uniform then)
+ * and is read-only after \ref build(), which keeps select() and pdf() consistent
+ * during the final render.
+ */
+class LightCacheSelector : public LightSelector {
+public:
+	static constexpr int NumSlots = 8;
+	static constexpr size_t TableSize = 1 << 17;
+	static constexpr int MaxProbes = 8;
+
+	LightCacheSelector(std::vector<AreaLight*>* lights, const AABB& bounds, int resolution = 64, float uniformProb = 0.5f);
+
+	using LightSelector::select;
+	using LightSelector::pdf;
+
+	AreaLight* select(float u) const;
+
+	float pdf(const AreaLight* light) const { return 1.0f / m_lights->size(); }
+
+	AreaLight* select(float u, const Vector3f& p, const Vector3f& n) const;
+
+	float pdf(const AreaLight* light, const Vector3f& p, const Vector3f& n) const;
+
+	void record(const AreaLight* light, const Vector3f& p, const Vector3f& n, float contribution);
+
+	// stop learning and freeze the per-cell distributions
+	void build();
+
+	bool isLearning() const { return m_learning; }
+
+	std::string toString() const;
+
+private:
+	struct Cell {
+		uint64_t key = 0; // 0 means empty
+		int count = 0;
+		float weightSum = 0.0f;
+		std::array<uint32_t, NumSlots> lights;
+		std::array<float, NumSlots> weights;
+		tbb::spin_mutex mutex;
+	};
+
+	uint64_t computeKey(const Vector3f& p, const Vector3f& n) const;
+
+	// find the cell of a key, or claim an empty one when insert is true
+	Cell* findCell(uint64_t key, bool insert);
+
+	const Cell* findCell(uint64_t key) const;
+
+	std::vector<Cell> m_cells;
+	Vector3f m_origin;
+	float m_invCellSize;
+	float m_uniformProb;
+	bool m_learning = true;
+};
+
+}
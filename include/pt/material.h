@@ -2,6 +2,8 @@
 
 #include <pt/vector.h>
 #include <pt/color.h>
+#include <pt/tangent.h>
+#include <memory>
 
 namespace pt {
 
@@ -14,6 +16,66 @@ struct BRDFSample {
 	bool specular = false;
 };
 
+struct BRDFEval {
+	Vector3f f = Vector3f(0.0f);
+	float pdf = 0.0f;
+};
+
+class BSDF;
+
+struct BSDFQuery {
+	const BSDF* bsdf;
+	Vector3f wi;
+};
+
+/**
+ * \brief BRDF of one shading point with a fixed outgoing direction
+ *
+ * Resolves the texture, the lobe weights and the reflected direction once per
+ * intersection, so evaluating or sampling it repeatedly (light sampling, RIS
+ * candidates, BRDF sampling) does not repeat them.
+ */
+class BSDF {
+public:
+	BSDF() : m_ts(Vector3f(0.0f, 0.0f, 1.0f)) { } // black body
+
+	BSDF(const Material* material, const Intersection& its, const Vector3f& wo);
+
+	// BRDF value and pdf of sampling wi together
+	BRDFEval eval(const Vector3f& wi) const;
+
+	BRDFSample sample(float uc, const Vector2f& u) const;
+
+	// evaluate several incident directions at once
+	void eval(const Vector3f* wi, BRDFEval* results, int count) const;
+
+	// evaluate many (closure, wi) pairs, 8 lanes at a time with AVX2
+	static void evalBatch(const BSDFQuery* queries, BRDFEval* results, int count);
+
+	// same surface seen from another outgoing direction (reverse pdfs in BDPT)
+	BSDF withOutgoing(const Vector3f& wo) const;
+
+	bool isSpecular() const { return m_mirror; }
+
+private:
+	friend class MaterialTable;
+
+	// lobe weights from the material parameters, a black body keeps the defaults
+	void setLobes(const Vector3f& diffuse, const Vector3f& specular, float shininess);
+
+	Vector3f m_diffuse = Vector3f(0.0f); // kd / pi
+	Vector3f m_specular = Vector3f(0.0f); // ks * (n + 2) / 2pi
+	float m_shininess = 1.0f;
+	float m_specPdfScale = 0.0f; // (n + 1) / 2pi
+	float m_specProb = 0.0f;
+	Vector3f m_n = Vector3f(0.0f, 0.0f, 1.0f);
+	Vector3f m_r = Vector3f(0.0f, 0.0f, 1.0f); // reflected wo
+	TangentSpace m_ts; // tangent space of shading normal
+	bool m_mirror = false;
+	bool m_black = true;
+	bool m_phong = false; // has a specular lobe
+};
+
 class Material {
 public:
 	Material(
@@ -25,27 +87,35 @@ public:
 		const float ior = 1.0f
 	) : m_name(name), m_diffuse(diffuse), m_specular(specular), m_transmittance(transmittance), m_shininess(shiness), m_ior(ior) { }
 
-	~Material() {
-		if (m_diffuse_texture != nullptr)
-			delete m_diffuse_texture;
-	}
-
 	std::string getName() const { return m_name; }
 
-	void setTexture(Bitmap* texture) { m_diffuse_texture = texture; }
+	// the texture may be shared with other materials
+	void setTexture(const std::shared_ptr<Texture>& texture) { m_diffuse_texture = texture; }
 
-	Bitmap* getTexture() const { return m_diffuse_texture; }
+	Texture* getTexture() const { return m_diffuse_texture.get(); }
 
 	Vector3f getBaseColor() const { return m_diffuse; }
 
 	Vector3f getBaseColor(const Vector2f& uv) const;
 
+	// filtered lookup using the uv footprint of the intersection
+	Vector3f getBaseColor(const Intersection& its) const;
+
 	Vector3f BRDF(const Vector3f& wo, const Vector3f& wi, const Intersection& its) const;
 
 	BRDFSample sampleBRDF(const Vector3f& wo, float uc, const Vector2f& u, const Intersection& its) const;
 
 	float pdf(const Vector3f& wo, const Vector3f& wi, const Intersection& its) const;
 
+	BSDF getBSDF(const Intersection& its, const Vector3f& wo) const { return BSDF(this, its, wo); }
+
+	const Vector3f& getSpecular() const { return m_specular; }
+
+	float getShininess() const { return m_shininess; }
+
+	// hard code
+	bool isMirror() const { return m_specular.x() > 999 || m_specular.y() > 999 || m_specular.z() > 999; }
+
 	std::string toString() const;
 
 private:
@@ -58,7 +128,7 @@ private:
 	float m_shininess;
 	float m_ior;
 
-	Bitmap* m_diffuse_texture = nullptr;
+	std::shared_ptr<Texture> m_diffuse_texture;
 };
 
 }
\ No newline at end of file
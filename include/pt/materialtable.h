@@ -0,0 +1,50 @@
+#pragma once
+
+#include <pt/common.h>
+#include <pt/material.h>
+
+namespace pt {
+
+enum class MaterialKind : uint8_t {
+	Black,
+	Lambert,
+	LambertPhong,
+	Mirror,
+	TexturedLambert,
+	TexturedLambertPhong
+};
+
+/**
+ * \brief Flat table of all scene materials used while shading
+ *
+ * Materials are classified once when the scene is preprocessed and their
+ * parameters are stored per field (structure of arrays), indexed by the global
+ * material id of a triangle. \ref getBSDF() dispatches on the kind with a single
+ * switch into kernels specialized at compile time, so an untextured surface
+ * never touches the texture code. The lobe weights are set up by the same
+ * BSDF::setLobes() as the BSDF constructor.
+ */
+class MaterialTable {
+public:
+	void build(const std::vector<Material*>& materials);
+
+	size_t size() const { return m_kinds.size(); }
+
+	MaterialKind getKind(uint32_t material_id) const { return m_kinds[material_id]; }
+
+	BSDF getBSDF(const Intersection& its, const Vector3f& wo) const;
+
+	std::string toString() const;
+
+private:
+	template <MaterialKind K>
+	BSDF makeBSDF(uint32_t id, const Intersection& its, const Vector3f& wo) const;
+
+	std::vector<MaterialKind> m_kinds;
+	std::vector<Vector3f> m_diffuse; // kd
+	std::vector<Vector3f> m_specular; // ks
+	std::vector<float> m_shininess;
+	std::vector<const Texture*> m_textures;
+};
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * \brief Philox4x32-10 counter based generator (Salmon et al., "Parallel
+ * random numbers: as easy as 1, 2, 3", SC 2011)
+ *
+ * Maps a 128-bit counter and a 64-bit key to 128 random bits without any
+ * state, so a value only depends on where it is used. philox4x32x8 runs
+ * 8 counters at once with AVX2 (a scalar loop otherwise).
+ */
+
+namespace pt {
+namespace philox {
+
+static constexpr uint32_t M0 = 0xD2511F53;
+static constexpr uint32_t M1 = 0xCD9E8D57;
+static constexpr uint32_t W0 = 0x9E3779B9;
+static constexpr uint32_t W1 = 0xBB67AE85;
+static constexpr int Rounds = 10;
+
+inline void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < Rounds; round++) {
+        uint64_t p0 = uint64_t(M0) * c0;
+        uint64_t p1 = uint64_t(M1) * c2;
+        uint32_t n0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+        c0 = n0; c1 = uint32_t(p1); c2 = n2; c3 = uint32_t(p0);
+        k0 += W0; k1 += W1;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+// 8 counters in SoA form (counter[i][lane]), out has the same layout
+inline void philox4x32x8(const uint32_t counter[4][8], const uint32_t key[2], uint32_t out[4][8]) {
+#if defined(__AVX2__)
+    __m256i c0 = _mm256_loadu_si256((const __m256i*) counter[0]);
+    __m256i c1 = _mm256_loadu_si256((const __m256i*) counter[1]);
+    __m256i c2 = _mm256_loadu_si256((const __m256i*) counter[2]);
+    __m256i c3 = _mm256_loadu_si256((const __m256i*) counter[3]);
+    const __m256i m0 = _mm256_set1_epi32(int(M0)), m1 = _mm256_set1_epi32(int(M1));
+    uint32_t k0 = key[0], k1 = key[1];
+
+    // high 32 bits of the 8 32x32 products
+    auto mulhi = [](__m256i a, __m256i m) {
+        __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(a, m), 32);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+        return _mm256_blend_epi32(even, odd, 0xaa);
+    };
+
+    for (int round = 0; round < Rounds; round++) {
+        __m256i hi0 = mulhi(c0, m0), lo0 = _mm256_mullo_epi32(c0, m0);
+        __m256i hi1 = mulhi(c2, m1), lo1 = _mm256_mullo_epi32(c2, m1);
+        c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(int(k0)));
+        c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(int(k1)));
+        c1 = lo1;
+        c3 = lo0;
+        k0 += W0; k1 += W1;
+    }
+
+    _mm256_storeu_si256((__m256i*) out[0], c0);
+    _mm256_storeu_si256((__m256i*) out[1], c1);
+    _mm256_storeu_si256((__m256i*) out[2], c2);
+    _mm256_storeu_si256((__m256i*) out[3], c3);
+#else
+    for (int lane = 0; lane < 8; lane++) {
+        uint32_t c[4] = { counter[0][lane], counter[1][lane], counter[2][lane], counter[3][lane] };
+        uint32_t r[4];
+        philox4x32(c, key, r);
+        for (int i = 0; i < 4; i++) out[i][lane] = r[i];
+    }
+#endif
+}
+
+// 24 random bits to [0, 1)
+inline float toUnitFloat(uint32_t v) {
+    return (v >> 8) * 0x1p-24f;
+}
+
+}
+}
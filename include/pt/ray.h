@@ -8,31 +8,24 @@ class Ray {
 public:
     Vector3f org;
     Vector3f dir;
-    Vector3f dir_rcp;
     float min_dis;
     float max_dis;
 
     Ray() : min_dis(Epsilon), max_dis(std::numeric_limits<float>::infinity()) { }
 
     Ray(const Ray& ray) : org(ray.org), dir(ray.dir), 
-        dir_rcp(ray.dir_rcp), min_dis(ray.min_dis), max_dis(ray.max_dis) { }
+        min_dis(ray.min_dis), max_dis(ray.max_dis) { }
 
     Ray(
         const Vector3f& o, 
         const Vector3f& d, 
         float min_d = Epsilon, 
         float max_d = std::numeric_limits<float>::infinity()
-    ) : org(o), dir(d), min_dis(min_d), max_dis(max_d) {
-        update();
-    }
-
-    void update() {
-        dir_rcp = dir.cwiseInverse();
-    }
+    ) : org(o), dir(d), min_dis(min_d), max_dis(max_d) { }
 
     Ray reverse() {
         Ray result;
-        result.org = org; result.dir = -dir; result.dir_rcp = -dir_rcp;
+        result.org = org; result.dir = -dir;
         result.min_dis = min_dis; result.max_dis = max_dis;
         return result;
     }
@@ -50,4 +43,28 @@ public:
     }
 };
 
+/**
+ * \brief Camera ray with two offset rays for one pixel step in x and y
+ *
+ * Used to estimate the texture filter footprint at the first hit.
+ */
+class RayDifferential : public Ray {
+public:
+    Vector3f rxOrg, ryOrg;
+    Vector3f rxDir, ryDir;
+    bool hasDifferentials = false;
+
+    RayDifferential() { }
+
+    RayDifferential(const Ray& ray) : Ray(ray) { }
+
+    // shrink the footprint when several samples share a pixel
+    void scaleDifferentials(float s) {
+        rxOrg = org + (rxOrg - org) * s;
+        ryOrg = org + (ryOrg - org) * s;
+        rxDir = dir + (rxDir - dir) * s;
+        ryDir = dir + (ryDir - dir) * s;
+    }
+};
+
 }
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <pt/common.h>
+#include <pt/block.h>
+#include <memory>
+#include <functional>
+
+namespace pt {
+
+struct RenderOptions {
+    BlockGenerator::Order tileOrder = BlockGenerator::Order::Spiral;
+    bool balanceTiles = false; // split and merge blocks by the cost measured in a 1 spp probe
+    CostHeatmap* heatmap = nullptr; // records the time of every block (and pixel)
+    std::function<void()> afterProbe; // called once the balancing probe finished, before the frame starts
+};
+
+/**
+ * \brief Render one frame of the scene into result
+ *
+ * The blocks are rendered in parallel on the TBB pool, by a render loop
+ * specialized for the concrete sampler and integrator types.
+ */
+void render(Scene* scene, Sampler* sampler, Integrator* integrator, ImageBlock* result, const RenderOptions& options = RenderOptions());
+
+/// Resolve the filtered samples (plus the scaled splats) of a frame into a bitmap
+std::unique_ptr<Bitmap> writeBitmap(ImageBlock* sampleBlock, ImageBlock* splatBlock = nullptr, float splatScale = 1.0);
+
+}
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <pt/common.h>
+#include <pt/philox.h>
 #include <pcg32.h>
+#include <memory>
 
 namespace sobol {
 
@@ -14,9 +16,55 @@ extern const uint32_t SobolMatrices32[NSobolDimensions * SobolMatrixSize];
 extern const uint64_t VdCSobolMatrices[][SobolMatrixSize];
 extern const uint64_t VdCSobolMatricesInv[][SobolMatrixSize];
 
-extern inline float sobolSample(int64_t a, int dimension);
+inline uint32_t sobolBits(int64_t a, int dimension) {
+    uint32_t v = 0;
+    // Compute initial Sobol\+$'$ sample _v_ using generator matrices
+    for (int i = dimension * SobolMatrixSize; a != 0; a >>= 1, i++)
+        if (a & 1)
+            v ^= SobolMatrices32[i];
+    return v;
+}
+
+inline float sobolToFloat(uint32_t v) {
+    return std::min(v * 0x1p-32f, FloatOneMinusEpsilon);
+}
+
+inline float sobolSample(int64_t a, int dimension) {
+    // No randomize
+    return sobolToFloat(sobolBits(a, dimension));
+}
+
+inline uint32_t reverseBits32(uint32_t n) {
+    n = (n << 16) | (n >> 16);
+    n = ((n & 0x00ff00ff) << 8) | ((n & 0xff00ff00) >> 8);
+    n = ((n & 0x0f0f0f0f) << 4) | ((n & 0xf0f0f0f0) >> 4);
+    n = ((n & 0x33333333) << 2) | ((n & 0xcccccccc) >> 2);
+    n = ((n & 0x55555555) << 1) | ((n & 0xaaaaaaaa) >> 1);
+    return n;
+}
+
+inline uint64_t mixBits(uint64_t v) {
+    v ^= (v >> 31);
+    v *= 0x7fb5d329728ea185;
+    v ^= (v >> 27);
+    v *= 0x81dadef4bc2dd44d;
+    v ^= (v >> 33);
+    return v;
+}
+
+// Hash based Owen scrambling (Laine-Karras permutation on the reversed bits),
+// each bit is flipped depending on the bits above it
+inline uint32_t fastOwenScramble(uint32_t v, uint32_t seed) {
+    v = reverseBits32(v);
+    v ^= v * 0x3d20adea;
+    v += seed;
+    v *= (seed >> 16) | 1;
+    v ^= v * 0x05526c56;
+    v ^= v * 0x53a22864;
+    return reverseBits32(v);
+}
 
-extern inline uint64_t sobolIntervalToIndex(uint32_t m, uint64_t frame, pt::Vector2i p);
+extern uint64_t sobolIntervalToIndex(uint32_t m, uint64_t frame, pt::Vector2i p);
 
 }
 
@@ -47,7 +95,8 @@ protected:
 };
 
 
-class IndependentSampler : public Sampler {
+// concrete samplers are final so the templated render loop can inline their calls
+class IndependentSampler final : public Sampler {
 public:
     IndependentSampler(uint32_t spp = 1) : Sampler(spp) { }
 
@@ -91,9 +140,28 @@ private:
 };
 
 
-class SobolSampler : public Sampler {
+/**
+ * \brief Global Sobol sampler (pbrt's SobolSampler without randomization)
+ *
+ * The sample index of a pixel sample is linear in the frame bits, so the
+ * samples of a pixel are taken in Gray-code order: consecutive samples differ
+ * in one frame bit, and the first CachedDimensions dimensions are updated with
+ * one XOR of a precomputed (pixel independent) column each. Higher dimensions
+ * are computed from the running Sobol index on demand.
+ *
+ * Dimensions from 2 on are Owen scrambled with a seed hashed from the pixel,
+ * the dimension and the sampler seed (the pixel dimensions stay unscrambled
+ * as they select the pixel). Paths longer than NSobolDimensions are padded
+ * with independent values hashed from the pixel, the dimension and the
+ * sample index: reusing the generator matrices would repeat the Sobol bits of
+ * an earlier dimension, and two scrambles of the same bits stay correlated.
+ */
+class SobolSampler final : public Sampler {
 public:
-    SobolSampler(uint32_t spp, Vector2i resolution);
+    static constexpr int CachedDimensions = 32;
+    static constexpr int MaxFrameBits = 32;
+
+    SobolSampler(uint32_t spp, Vector2i resolution, uint32_t seed = 0);
 
     std::unique_ptr<Sampler> clone() const;
 
@@ -101,29 +169,200 @@ public:
 
     void startPixelSample(const Vector2i& p, int sampleIndex);
 
-    inline float sample1D();
+    inline float sample1D() {
+        return sampleDimension(m_dimension++);
+    }
 
-    inline Vector2f sample2D();
+    inline Vector2f sample2D() {
+        Vector2f u(sampleDimension(m_dimension), sampleDimension(m_dimension + 1));
+        m_dimension += 2;
+        return u;
+    }
 
-    inline Vector2f samplePixel2D();
+    inline Vector2f samplePixel2D() {
+        Vector2f u(sobol::sobolToFloat(m_values[0]), sobol::sobolToFloat(m_values[1]));
+        // Remap Sobol\+$'$ dimensions used for pixel samples
+        for (int dim = 0; dim < 2; ++dim) {
+            u[dim] = std::clamp(u[dim] * m_scale - m_pixel[dim], 0.0f, sobol::FloatOneMinusEpsilon);
+        }
+        return u;
+    }
 
     std::string toString() const {
         return tfm::format(
             "SobolSampler[\n"
             "  spp = %i,\n"
             "  NSobolDimensions = %i,\n"
-            "  SobolMatrixSize = %i\n"
+            "  SobolMatrixSize = %i,\n"
+            "  CachedDimensions = %i,\n"
+            "  seed = %i\n"
             "]",
-            m_spp, sobol::NSobolDimensions, sobol::SobolMatrixSize
+            m_spp, sobol::NSobolDimensions, sobol::SobolMatrixSize, CachedDimensions, m_seed
         );
     }
 
 private:
-    float sampleDimension(int dimension) const { return sobol::sobolSample(m_sobolIndex, dimension); }
+    // pixel independent columns, shared by all clones
+    struct FrameColumns {
+        int bits;
+        uint64_t index[MaxFrameBits]; // change of the Sobol index when frame bit c flips
+        alignas(32) uint32_t values[MaxFrameBits][CachedDimensions]; // same for the cached dimensions
+    };
+
+    uint32_t dimensionSeed(int dimension) const {
+        return uint32_t(sobol::mixBits(m_pixelHash ^ (uint64_t(dimension) * 0x9e3779b97f4a7c15)));
+    }
 
+    // scrambled sample of a dimension >= 2
+    float sampleDimension(int dimension) const {
+        if (dimension < CachedDimensions)
+            return sobol::sobolToFloat(sobol::fastOwenScramble(m_values[dimension], m_seeds[dimension]));
+        if (dimension < sobol::NSobolDimensions) {
+            uint32_t bits = sobol::sobolBits(m_sobolIndex, dimension);
+            return sobol::sobolToFloat(sobol::fastOwenScramble(bits, dimensionSeed(dimension)));
+        }
+        uint64_t hash = sobol::mixBits(uint64_t(dimensionSeed(dimension)) << 32 | uint32_t(m_sampleIndex));
+        return sobol::sobolToFloat(uint32_t(hash >> 32));
+    }
+
+    std::shared_ptr<const FrameColumns> m_columns;
+    alignas(32) uint32_t m_values[CachedDimensions];
+    uint32_t m_seeds[CachedDimensions]; // scrambling seeds of the cached dimensions for m_pixel
+    uint64_t m_pixelHash;
+    uint32_t m_seed;
     int64_t m_sobolIndex;
-    int m_dimension, m_scale;
+    int m_sampleIndex;
+    int m_dimension, m_scale, m_log2Scale;
+    Vector2i m_pixel;
+};
+
+
+/**
+ * \brief Z-order Sobol sampler (pbrt-v4's ZSobolSampler)
+ *
+ * Pixels are enumerated along a Morton curve and the samples of a pixel are
+ * appended to the pixel index, so every pixel gets a contiguous, stratified
+ * range of a 2D Sobol sequence. The base-4 digits of that index are shuffled
+ * with permutations hashed from the higher digits and the dimension, which
+ * decorrelates the dimensions and spreads the error over the image as blue
+ * noise. Each dimension pair is then Owen scrambled.
+ */
+class ZSobolSampler final : public Sampler {
+public:
+    ZSobolSampler(uint32_t spp, Vector2i resolution, uint32_t seed = 0);
+
+    std::unique_ptr<Sampler> clone() const {
+        return std::unique_ptr<Sampler>(new ZSobolSampler(*this));
+    }
+
+    void startBlockSample(const Vector2i& offset) { }
+
+    void startPixelSample(const Vector2i& p, int sampleIndex) {
+        m_dimension = 0;
+        m_mortonIndex = (encodeMorton2(uint32_t(p.x()), uint32_t(p.y())) << m_log2SPP) | uint32_t(sampleIndex);
+    }
+
+    float sample1D();
+
+    Vector2f sample2D();
+
+    inline Vector2f samplePixel2D() { return sample2D(); }
+
+    std::string toString() const {
+        return tfm::format(
+            "ZSobolSampler[\n"
+            "  spp = %i,\n"
+            "  base4_digits = %i,\n"
+            "  seed = %i\n"
+            "]",
+            m_spp, m_base4Digits, m_seed
+        );
+    }
+
+private:
+    // position of the current sample in the 2D Sobol sequence of the current dimension
+    uint64_t getSampleIndex() const;
+
+    int m_log2SPP, m_base4Digits;
+    uint32_t m_seed;
+    uint64_t m_mortonIndex;
+    int m_dimension;
+};
+
+
+/**
+ * \brief Stateless sampler built on the Philox4x32-10 counter based generator
+ *
+ * Dimension d of sample s in pixel p is word d % 4 of the Philox block with
+ * counter (p.x, p.y, s, d / 4) and the seed as key. Any sample can be
+ * computed on its own, so the sample values do not depend on the block size
+ * or on the thread a block runs on. The film only matches bit for bit with
+ * --fis: with a filter, the overlapping tile borders are summed in scheduling
+ * order. Blocks are generated 8 at a time (32 dimensions per batch) with AVX2.
+ */
+class PhiloxSampler final : public Sampler {
+public:
+    static constexpr int BatchSize = 32; // dimensions per batch, 8 Philox blocks
+
+    PhiloxSampler(uint32_t spp = 1, uint32_t seed = 0) : Sampler(spp), m_seed(seed) { }
+
+    std::unique_ptr<Sampler> clone() const {
+        return std::unique_ptr<Sampler>(new PhiloxSampler(*this));
+    }
+
+    void startBlockSample(const Vector2i& offset) { }
+
+    void startPixelSample(const Vector2i& p, int sampleIndex) {
+        m_pixel = p;
+        m_sampleIndex = sampleIndex;
+        m_dimension = 2;
+        m_batch = -1;
+    }
+
+    inline float sample1D() {
+        return sampleDimension(m_dimension++);
+    }
+
+    inline Vector2f sample2D() {
+        Vector2f u(sampleDimension(m_dimension), sampleDimension(m_dimension + 1));
+        m_dimension += 2;
+        return u;
+    }
+
+    inline Vector2f samplePixel2D() {
+        return Vector2f(sampleDimension(0), sampleDimension(1));
+    }
+
+    /// Value of one dimension of a sample, without any sampler state
+    static float sample(const Vector2i& p, int sampleIndex, int dimension, uint32_t seed = 0);
+
+    std::string toString() const {
+        return tfm::format(
+            "PhiloxSampler[\n"
+            "  spp = %i,\n"
+            "  seed = %i\n"
+            "]",
+            m_spp, m_seed
+        );
+    }
+
+private:
+    inline float sampleDimension(int dimension) {
+        int batch = dimension / BatchSize;
+        if (batch != m_batch)
+            generateBatch(batch);
+        return philox::toUnitFloat(m_values[dimension % BatchSize]);
+    }
+
+    // fill m_values with dimensions [batch * BatchSize, (batch + 1) * BatchSize)
+    void generateBatch(int batch);
+
+    uint32_t m_seed;
     Vector2i m_pixel;
+    int m_sampleIndex = 0;
+    int m_dimension = 2;
+    int m_batch = -1;
+    uint32_t m_values[BatchSize];
 };
 
 }
\ No newline at end of file
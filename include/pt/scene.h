@@ -1,6 +1,9 @@
 #pragma once
 
 #include <pt/common.h>
+#include <pt/aabb.h>
+#include <pt/texture.h>
+#include <pt/materialtable.h>
 
 namespace pt {
 
@@ -15,15 +18,7 @@ class Scene {
 public:
     Scene() { }
 
-    ~Scene() {
-        delete m_accel;
-        delete m_camera;
-        delete m_filter;
-        delete m_light_selector;
-        for (auto p : m_meshes) delete p;
-        for (auto p : m_materials) delete p;
-        for (auto p : m_shapes) delete p;
-    }
+    ~Scene();
 
     // Load mesh and material from OBJ file
     void loadOBJ(const std::string& filename);
@@ -46,6 +41,9 @@ public:
     // Get material by index
     Material* getMaterial(const uint32_t material_id);
 
+    // Get flat material table used for shading
+    const MaterialTable& getMaterialTable() const { return m_material_table; }
+
     // Get material by intersection
     //Material* getMaterial(const Intersection& its);
 
@@ -58,7 +56,7 @@ public:
     // if unocculded between p0 and p1
     bool unocculded(Vector3f p0, Vector3f p1, const Vector3f& n0 = Vector3f(0.0), const Vector3f& n1 = Vector3f(0.0)) const;
 
-    // Create primitives, build accelration struction and integrator
+    // Create primitives, build accelration struction and integrator (waits for texture decoding)
     void preprocess();
 
     // Get primitives
@@ -67,8 +65,20 @@ public:
     // Get filter
     Filter* getFilter() const { return m_filter; }
 
+    // Place camera samples by importance sampling the filter (films then use no filter)
+    const FilterSampler* enableFilterSampling();
+
+    // Get filter sampler, nullptr unless filter importance sampling is enabled
+    const FilterSampler* getFilterSampler() const { return m_filter_sampler; }
+
     // Get light selector
-    UniformLightSelector* getLightSelector() const { return m_light_selector; }
+    LightSelector* getLightSelector() const { return m_light_selector; }
+
+    // Replace the uniform light selector with a learned light importance cache
+    LightCacheSelector* enableLightCache();
+
+    // Get bounding box of all primitives
+    const AABB& getBounds() const { return m_bounds; }
 
     std::string toString() const;
 
@@ -84,9 +94,13 @@ private:
     std::vector<AreaLight*> m_lights;
 
     Camera* m_camera = nullptr;
-    Accel* m_accel = nullptr;
+    BVHTree* m_accel = nullptr; // concrete type, traversal calls are not virtual
     Filter* m_filter = nullptr;
-    UniformLightSelector* m_light_selector = nullptr;
+    FilterSampler* m_filter_sampler = nullptr;
+    LightSelector* m_light_selector = nullptr;
+    AABB m_bounds;
+    TextureManager m_textures;
+    MaterialTable m_material_table;
 };
 
 }
\ No newline at end of file
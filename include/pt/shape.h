@@ -15,8 +15,8 @@ struct TriangleSample {
 
 class Triangle {
 public:
-	Triangle(uint32_t triangle_id, TriangleMesh* mesh, Material* material, AreaLight* light = nullptr) : 
-		m_triangle_id(triangle_id), m_mesh(mesh), m_material(material), m_light(light) { }
+	Triangle(uint32_t triangle_id, TriangleMesh* mesh, Material* material, uint32_t material_id, AreaLight* light = nullptr) : 
+		m_triangle_id(triangle_id), m_material_id(material_id), m_mesh(mesh), m_material(material), m_light(light) { }
 
 	// Calculate surface area
 	float surfaceArea() const;
@@ -44,6 +44,9 @@ public:
 	// Get material
 	const Material* getMaterial() const { return m_material;  };
 
+	// Get global material index (into the scene material table)
+	uint32_t getMaterialId() const { return m_material_id; }
+
 	// Get mesh
 	TriangleMesh* getMesh() const { return m_mesh; }
 
@@ -57,6 +60,7 @@ public:
 
 private:
 	uint32_t m_triangle_id;
+	uint32_t m_material_id;
 	TriangleMesh* m_mesh = nullptr;
 	const Material* m_material = nullptr;
 	AreaLight* m_light = nullptr;
@@ -76,10 +80,18 @@ public:
 
 	const Material* getMaterial() const { return m_shape ? m_shape->getMaterial() : nullptr; }
 
+	uint32_t getMaterialId() const { return m_shape->getMaterialId(); }
+
 	const AreaLight* getLight() const { return m_shape ? m_shape->getLight() : nullptr; }
 
 	void complete();
 
+	// estimate uv derivatives per pixel from the camera ray differentials
+	void computeDifferentials(const RayDifferential& ray);
+
+	// filter width of texture lookups in uv space (0 without differentials)
+	float getUVFootprint() const { return std::max(std::max(std::abs(dudx), std::abs(dvdx)), std::max(std::abs(dudy), std::abs(dvdy))); }
+
 	Vector3f Le(const Vector3f& w) const;
 
 	Vector3f BRDF(const Vector3f& wo, const Vector3f& wi) const;
@@ -95,6 +107,8 @@ public:
 	Vector3f ng; // geometric normal
 	Vector2f uv;
 	TangentSpace ts; // tangent space of shading normal
+	float dudx = 0.0f, dvdx = 0.0f; // uv derivatives per pixel
+	float dudy = 0.0f, dvdy = 0.0f;
 
 private:
 	const Triangle* m_shape = nullptr;
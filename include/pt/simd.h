@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * \brief Small set of 8-wide float helpers used by the batched BRDF code
+ *
+ * Compiled only when AVX2 is enabled (PT_ENABLE_AVX2), callers keep a scalar
+ * path otherwise. log/exp follow the Cephes single precision polynomials
+ * (about 1 ulp on the reduced range).
+ */
+
+namespace pt {
+namespace simd {
+
+#if defined(__AVX2__)
+
+constexpr int Width = 8;
+
+inline __m256 log(__m256 x) {
+    // x = m * 2^e with m in [sqrt(0.5), sqrt(2))
+    __m256i xi = _mm256_castps_si256(x);
+    __m256i e = _mm256_sub_epi32(_mm256_srli_epi32(xi, 23), _mm256_set1_epi32(127));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+        _mm256_and_si256(xi, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+    __m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+    m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+    __m256 fe = _mm256_cvtepi32_ps(e);
+    fe = _mm256_add_ps(fe, _mm256_and_ps(big, _mm256_set1_ps(1.0f)));
+
+    __m256 f = _mm256_sub_ps(m, _mm256_set1_ps(1.0f));
+    __m256 z = _mm256_mul_ps(f, f);
+    __m256 y = _mm256_set1_ps(7.0376836292e-2f);
+    y = _mm256_add_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(-1.1514610310e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(1.1676998740e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(-1.2420140846e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(1.4249322787e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(-1.6668057665e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(2.0000714765e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(-2.4999993993e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(3.3333331174e-1f));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, f), z);
+
+    y = _mm256_add_ps(y, _mm256_mul_ps(fe, _mm256_set1_ps(-2.12194440e-4f)));
+    y = _mm256_sub_ps(y, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+    return _mm256_add_ps(_mm256_add_ps(f, y), _mm256_mul_ps(fe, _mm256_set1_ps(0.693359375f)));
+}
+
+inline __m256 exp(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.3365f)), _mm256_set1_ps(88.3762f));
+
+    // x = g + n * ln2
+    __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 g = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(0.693359375f)));
+    g = _mm256_sub_ps(g, _mm256_mul_ps(n, _mm256_set1_ps(-2.12194440e-4f)));
+
+    __m256 y = _mm256_set1_ps(1.9875691500e-4f);
+    y = _mm256_add_ps(_mm256_mul_ps(y, g), _mm256_set1_ps(1.3981999507e-3f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, g), _mm256_set1_ps(8.3334519073e-3f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, g), _mm256_set1_ps(4.1665795894e-2f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, g), _mm256_set1_ps(1.6666665459e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, g), _mm256_set1_ps(5.0000001201e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(y, g), g), _mm256_add_ps(g, _mm256_set1_ps(1.0f)));
+
+    // scale by 2^n (n is in [-126, 127] after clamping)
+    __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(e));
+}
+
+// x^y for x >= 0, pow(0, y) = 0 for y > 0 and 1 for y == 0 like std::pow
+inline __m256 pow(__m256 x, __m256 y) {
+    __m256 zero = _mm256_setzero_ps();
+    __m256 positive = _mm256_cmp_ps(x, zero, _CMP_GT_OQ);
+    __m256 safeX = _mm256_blendv_ps(_mm256_set1_ps(1.0f), x, positive);
+    __m256 result = exp(_mm256_mul_ps(y, log(safeX)));
+    __m256 atZero = _mm256_and_ps(_mm256_cmp_ps(y, zero, _CMP_EQ_OQ), _mm256_set1_ps(1.0f));
+    return _mm256_blendv_ps(atZero, result, positive);
+}
+
+inline __m256 abs(__m256 x) {
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x);
+}
+
+#else
+
+constexpr int Width = 1;
+
+#endif
+
+}
+}
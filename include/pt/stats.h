@@ -0,0 +1,112 @@
+#pragma once
+
+#include <pt/common.h>
+#include <climits>
+
+/**
+ * \brief Render statistics in the style of pbrt
+ *
+ * Statistics are declared at namespace scope with the PT_STAT_* macros and
+ * updated in per-thread slots, so the hot paths never take a lock or share
+ * a cache line. The slots of a thread are registered on its first update
+ * and summed by \ref pt::stats::print(). Without PT_ENABLE_STATS (the CMake
+ * option of the same name) all macros expand to nothing.
+ *
+ *     PT_STAT_COUNTER(statRays, "Integrator", "Camera rays");
+ *     ...
+ *     PT_STAT_ADD(statRays, 1);
+ */
+
+namespace pt {
+namespace stats {
+
+#if defined(PT_ENABLE_STATS)
+
+enum class Kind { Counter, Ratio, Distribution, Histogram };
+
+constexpr int MaxStats = 64;
+constexpr int HistogramBins = 16; // the last bin also counts all larger values
+
+struct Slot {
+    int64_t count = 0; // counter value, ratio numerator or number of samples
+    int64_t total = 0; // ratio denominator or sum of the samples
+    int64_t min = LLONG_MAX, max = LLONG_MIN;
+    int64_t bins[HistogramBins] = {};
+
+    void merge(const Slot& other);
+};
+
+/// Slots of one thread, registered on construction and folded into the totals when the thread exits
+struct ThreadStats {
+    ThreadStats();
+    ~ThreadStats();
+
+    Slot slots[MaxStats];
+};
+
+inline ThreadStats& local() {
+    static thread_local ThreadStats stats;
+    return stats;
+}
+
+class Stat {
+public:
+    Stat(const char* category, const char* name, Kind kind);
+
+    void add(int64_t value) const { local().slots[m_id].count += value; }
+
+    void addRatio(int64_t num, int64_t denom) const {
+        Slot& slot = local().slots[m_id];
+        slot.count += num;
+        slot.total += denom;
+    }
+
+    void sample(int64_t value) const {
+        Slot& slot = local().slots[m_id];
+        slot.count++;
+        slot.total += value;
+        slot.min = std::min(slot.min, value);
+        slot.max = std::max(slot.max, value);
+        if (m_histogram)
+            slot.bins[std::clamp<int64_t>(value, 0, HistogramBins - 1)]++;
+    }
+
+private:
+    int m_id;
+    bool m_histogram;
+};
+
+/// Sum the statistics of all threads and print them grouped by category
+void print(std::ostream& os);
+
+/// Reset the statistics of all threads, no thread may be updating them meanwhile
+void clear();
+
+#define PT_STAT_COUNTER(var, category, name) static const pt::stats::Stat var(category, name, pt::stats::Kind::Counter)
+#define PT_STAT_RATIO(var, category, name) static const pt::stats::Stat var(category, name, pt::stats::Kind::Ratio)
+#define PT_STAT_DISTRIBUTION(var, category, name) static const pt::stats::Stat var(category, name, pt::stats::Kind::Distribution)
+#define PT_STAT_HISTOGRAM(var, category, name) static const pt::stats::Stat var(category, name, pt::stats::Kind::Histogram)
+#define PT_STAT_ADD(var, value) var.add(value)
+#define PT_STAT_RATIO_ADD(var, num, denom) var.addRatio(num, denom)
+#define PT_STAT_SAMPLE(var, value) var.sample(value)
+#define PT_STATS_ONLY(...) __VA_ARGS__
+
+#else
+
+inline void print(std::ostream& os) { }
+
+inline void clear() { }
+
+#define PT_STAT_COUNTER(var, category, name)
+#define PT_STAT_RATIO(var, category, name)
+#define PT_STAT_DISTRIBUTION(var, category, name)
+#define PT_STAT_HISTOGRAM(var, category, name)
+#define PT_STAT_ADD(var, value) ((void) 0)
+#define PT_STAT_RATIO_ADD(var, num, denom) ((void) 0)
+#define PT_STAT_SAMPLE(var, value) ((void) 0)
+#define PT_STATS_ONLY(...)
+
+#endif
+
+}
+}
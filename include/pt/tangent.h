@@ -1,6 +1,7 @@
 #pragma once
 
 #include <pt/common.h>
+#include <pt/vec.h>
 
 namespace pt {
 
@@ -17,25 +18,28 @@ public:
 		float sign = std::copysignf(1.0f, normal.z());
 		float a = -1.0f / (sign + normal.z());
 		float b = normal.x() * normal.y() * a;
-		m_t = Vector3f(1.0f + sign * normal.x() * normal.x() * a, sign * b, -sign * normal.x());
-		m_b = Vector3f(b, sign + normal.y() * normal.y() * a, -normal.y());
-		if (std::abs(m_n.norm() - 1.0) > 1e-4) cout << "false TangentSpace m_n " << m_n.norm() << endl;
-		if (std::abs(m_t.norm() - 1.0) > 1e-4) cout << "false TangentSpace m_t " << m_t.norm() << endl;
-		if (std::abs(m_b.norm() - 1.0) > 1e-4) cout << "false TangentSpace m_b " << m_b.norm() << endl;
+		m_t = Vec3(1.0f + sign * normal.x() * normal.x() * a, sign * b, -sign * normal.x());
+		m_b = Vec3(b, sign + normal.y() * normal.y() * a, -normal.y());
+#ifndef NDEBUG
+		if (std::abs(normal.norm() - 1.0) > 1e-4) cout << "false TangentSpace m_n " << normal.norm() << endl;
+		if (std::abs(m_t.toVector().norm() - 1.0) > 1e-4) cout << "false TangentSpace m_t " << m_t.toVector().norm() << endl;
+		if (std::abs(m_b.toVector().norm() - 1.0) > 1e-4) cout << "false TangentSpace m_b " << m_b.toVector().norm() << endl;
+#endif
 	}
 
 	Vector3f toLocal(const Vector3f& v) const {
-		return Vector3f(m_t.dot(v), m_b.dot(v), m_n.dot(v));
+		Vec3 w(v);
+		return Vector3f(dot(m_t, w), dot(m_b, w), dot(m_n, w));
 	}
 
 	Vector3f toWorld(const Vector3f& v) const {
-		return m_t * v.x() + m_b * v.y() + m_n * v.z();
+		return (m_t * v.x() + m_b * v.y() + m_n * v.z()).toVector();
 	}
 
 private:
-	Vector3f m_t; // tangent
-	Vector3f m_b; // bitangent
-	Vector3f m_n; // normal
+	Vec3 m_t; // tangent
+	Vec3 m_b; // bitangent
+	Vec3 m_n; // normal
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <pt/common.h>
+#include <pt/color.h>
+#include <tbb/task_group.h>
+#include <unordered_map>
+#include <memory>
+
+namespace pt {
+
+/**
+ * \brief MIP-mapped RGB texture used by materials
+ *
+ * Texels are kept as 8-bit sRGB (as stored in the PNG/JPG source) and are
+ * decoded to linear RGB through a 256-entry lookup table at every fetch.
+ * By default every level is stored in 4x4 tiles of RGBA8 texels, so a tile is
+ * exactly one 64-byte cache line. The four taps of a bilinear lookup share a
+ * line only if they do not straddle a tile border; 7 of the 16 footprint
+ * positions in a tile do (two or four lines). The padding to RGBA8 takes 33%
+ * more memory than packed RGB8 texels.
+ * The pyramid is built with a 2x2 box filter (in linear space) when the
+ * texture is loaded. Lookups pick (and blend) the two levels matching the
+ * filter footprint.
+ */
+class Texture {
+public:
+    enum class Layout { RowMajor, Tiled };
+
+    Texture(const std::string& name = "") : m_name(name) { }
+
+    /// Load an PNG/JPG file (with sRGB tonemapping) and build the MIP pyramid
+    void load(const std::string& filename, Layout layout = Layout::Tiled);
+
+    /// Build the texture from 8-bit sRGB RGB texels (row major)
+    void setData(int width, int height, const uint8_t* rgb8, Layout layout = Layout::Tiled);
+
+    /// Bilinear lookup in the finest level
+    Color3f sample(const Vector2f& uv) const;
+
+    /// Trilinear lookup, width is the footprint of the lookup in uv space
+    Color3f sample(const Vector2f& uv, float width) const;
+
+    int getLevelCount() const { return int(m_levels.size()); }
+
+    Vector2i getSize() const {
+        return m_levels.empty() ? Vector2i(0) : Vector2i(m_levels[0].width, m_levels[0].height);
+    }
+
+    /// Memory used by all levels in bytes
+    size_t getMemorySize() const;
+
+    std::string toString() const {
+        Vector2i size = getSize();
+        return tfm::format(
+            "Texture[\n"
+            "  name = %s,\n"
+            "  size = [ %i, %i ],\n"
+            "  levels = %i,\n"
+            "  layout = %s,\n"
+            "  memory = %i KB\n"
+            "]",
+            m_name, size.x(), size.y(), m_levels.size(),
+            m_layout == Layout::Tiled ? "tiled" : "row major", getMemorySize() / 1024
+        );
+    }
+
+private:
+    static constexpr int TileSize = 4; // index() relies on 4x4 tiles
+
+    // one tile of RGBA8 texels (sRGB), one cache line
+    struct alignas(64) Tile {
+        uint32_t texels[TileSize * TileSize];
+    };
+
+    struct Level {
+        int width = 0, height = 0;
+        int tilesX = 0;
+        std::vector<Tile> tiles; // also used as flat storage by the row major layout
+
+        void resize(int w, int h);
+
+        template <Layout L>
+        inline size_t index(int x, int y) const {
+            if constexpr (L == Layout::Tiled)
+                return ((size_t(uint32_t(y) >> 2) * tilesX + (uint32_t(x) >> 2)) << 4) |
+                    ((uint32_t(y) & 3) << 2) | (uint32_t(x) & 3);
+            else
+                return size_t(y) * width + x;
+        }
+
+        template <Layout L>
+        inline const uint8_t* texel(int x, int y) const {
+            return reinterpret_cast<const uint8_t*>(tiles.data()->texels + index<L>(x, y));
+        }
+
+        template <Layout L>
+        inline uint8_t* texel(int x, int y) {
+            return reinterpret_cast<uint8_t*>(tiles.data()->texels + index<L>(x, y));
+        }
+    };
+
+    template <Layout L>
+    void buildPyramid();
+
+    template <Layout L>
+    Color3f sampleLevel(int level, const Vector2f& uv) const;
+
+    Color3f sampleLevel(int level, const Vector2f& uv) const {
+        return m_layout == Layout::Tiled ?
+            sampleLevel<Layout::Tiled>(level, uv) : sampleLevel<Layout::RowMajor>(level, uv);
+    }
+
+    std::string m_name;
+    Layout m_layout = Layout::Tiled;
+    std::vector<Level> m_levels;
+};
+
+/**
+ * \brief Shares textures between materials and decodes them in the background
+ *
+ * Textures are keyed by their canonical path, so materials referencing the
+ * same image get the same object. Every unique image is decoded by a task on
+ * the TBB pool; \ref wait() has to be called before any texture is sampled.
+ * \ref request() is not thread safe and is meant to be called by the loader.
+ */
+class TextureManager {
+public:
+    TextureManager() { }
+
+    ~TextureManager();
+
+    /// Get the texture of an image file, start decoding it if it is new
+    std::shared_ptr<Texture> request(const std::string& filename);
+
+    /// Wait until all requested textures are decoded
+    void wait();
+
+    size_t getTextureCount() const { return m_textures.size(); }
+
+    std::string toString() const;
+
+private:
+    std::unordered_map<std::string, std::shared_ptr<Texture>> m_textures;
+    tbb::task_group m_tasks;
+};
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <pt/common.h>
+#include <chrono>
+
+/**
+ * \brief Timeline of scoped events written as Chrome trace-event JSON
+ *
+ * The file can be opened in Perfetto (ui.perfetto.dev) or chrome://tracing.
+ * Tracing is off until \ref pt::trace::start() is called, a disabled scope
+ * costs a single branch. Events are buffered per thread and written by
+ * \ref pt::trace::stop(), which has to run once all traced work finished.
+ *
+ *     PT_TRACE_SCOPE("Build BVH", "scene");
+ */
+
+namespace pt {
+namespace trace {
+
+/// Start recording, the events are written to filename by \ref stop()
+void start(const std::string& filename);
+
+/// Stop recording and write the trace file
+void stop();
+
+bool isEnabled();
+
+/// Records the time between construction and destruction as one event
+class Scope {
+public:
+    /// args is the body of a JSON object shown with the event, e.g. "\"x\": 32"
+    Scope(const char* name, const char* category, const std::string& args = "") {
+        if (isEnabled()) begin(name, category, args);
+    }
+
+    ~Scope() {
+        if (m_active) end();
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator = (const Scope&) = delete;
+
+private:
+    void begin(const char* name, const char* category, const std::string& args);
+    void end();
+
+    bool m_active = false;
+    std::string m_name, m_args;
+    const char* m_category = nullptr;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+}
+}
+
+#define PT_TRACE_CONCAT_(a, b) a##b
+#define PT_TRACE_CONCAT(a, b) PT_TRACE_CONCAT_(a, b)
+#define PT_TRACE_SCOPE(...) pt::trace::Scope PT_TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <pt/common.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PT_SIMD_SSE 1
+#include <immintrin.h>
+#endif
+
+/**
+ * \brief Aligned SIMD vector types for the hot paths (traversal, intersection)
+ *
+ * Vec3 is a single 3D vector stored in one 16-byte SSE register (w unused).
+ * Vec3x4 and Vec3x8 hold 4 / 8 vectors in SoA form (one register per axis),
+ * built from the Float4 / Float8 packs. Float8 needs AVX2, the packs need
+ * SSE2 (always available on x86-64) and Vec3 falls back to plain floats
+ * without it. Code using the packs keeps a scalar path when PT_SIMD_SSE is
+ * not defined.
+ */
+
+namespace pt {
+
+#if defined(PT_SIMD_SSE)
+
+struct alignas(16) Vec3 {
+    __m128 m;
+
+    Vec3() : m(_mm_setzero_ps()) { }
+    Vec3(__m128 v) : m(v) { }
+    explicit Vec3(float v) : m(_mm_set1_ps(v)) { }
+    Vec3(float x, float y, float z) : m(_mm_setr_ps(x, y, z, 0.0f)) { }
+    Vec3(const Vector3f& v) : m(_mm_setr_ps(v.x(), v.y(), v.z(), 0.0f)) { }
+
+    Vector3f toVector() const {
+        alignas(16) float v[4];
+        _mm_store_ps(v, m);
+        return Vector3f(v[0], v[1], v[2]);
+    }
+
+    float x() const { return _mm_cvtss_f32(m); }
+    float y() const { return _mm_cvtss_f32(_mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1))); }
+    float z() const { return _mm_cvtss_f32(_mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2))); }
+
+    Vec3 operator + (const Vec3& b) const { return _mm_add_ps(m, b.m); }
+    Vec3 operator - (const Vec3& b) const { return _mm_sub_ps(m, b.m); }
+    Vec3 operator * (const Vec3& b) const { return _mm_mul_ps(m, b.m); }
+    Vec3 operator * (float s) const { return _mm_mul_ps(m, _mm_set1_ps(s)); }
+    Vec3 operator - () const { return _mm_xor_ps(m, _mm_set1_ps(-0.0f)); }
+};
+
+inline Vec3 min(const Vec3& a, const Vec3& b) { return _mm_min_ps(a.m, b.m); }
+inline Vec3 max(const Vec3& a, const Vec3& b) { return _mm_max_ps(a.m, b.m); }
+
+// 1 / v, w stays finite
+inline Vec3 rcp(const Vec3& v) {
+    return _mm_div_ps(_mm_set1_ps(1.0f), _mm_or_ps(v.m, _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+inline float hmin(const Vec3& v) {
+    __m128 a = _mm_min_ps(v.m, _mm_shuffle_ps(v.m, v.m, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(_mm_min_ss(a, _mm_shuffle_ps(v.m, v.m, _MM_SHUFFLE(2, 2, 2, 2))));
+}
+
+inline float hmax(const Vec3& v) {
+    __m128 a = _mm_max_ps(v.m, _mm_shuffle_ps(v.m, v.m, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(_mm_max_ss(a, _mm_shuffle_ps(v.m, v.m, _MM_SHUFFLE(2, 2, 2, 2))));
+}
+
+inline float dot(const Vec3& a, const Vec3& b) {
+    __m128 p = _mm_mul_ps(a.m, b.m);
+    __m128 s = _mm_add_ss(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2))));
+}
+
+inline Vec3 cross(const Vec3& a, const Vec3& b) {
+    __m128 a_yzx = _mm_shuffle_ps(a.m, a.m, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 b_yzx = _mm_shuffle_ps(b.m, b.m, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a.m, b_yzx), _mm_mul_ps(a_yzx, b.m));
+    return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+#else
+
+struct Vec3 {
+    float v[4];
+
+    Vec3() : v{ 0.0f, 0.0f, 0.0f, 0.0f } { }
+    explicit Vec3(float s) : v{ s, s, s, s } { }
+    Vec3(float x, float y, float z) : v{ x, y, z, 0.0f } { }
+    Vec3(const Vector3f& a) : v{ a.x(), a.y(), a.z(), 0.0f } { }
+
+    Vector3f toVector() const { return Vector3f(v[0], v[1], v[2]); }
+
+    float x() const { return v[0]; }
+    float y() const { return v[1]; }
+    float z() const { return v[2]; }
+
+    Vec3 operator + (const Vec3& b) const { return Vec3(v[0] + b.v[0], v[1] + b.v[1], v[2] + b.v[2]); }
+    Vec3 operator - (const Vec3& b) const { return Vec3(v[0] - b.v[0], v[1] - b.v[1], v[2] - b.v[2]); }
+    Vec3 operator * (const Vec3& b) const { return Vec3(v[0] * b.v[0], v[1] * b.v[1], v[2] * b.v[2]); }
+    Vec3 operator * (float s) const { return Vec3(v[0] * s, v[1] * s, v[2] * s); }
+    Vec3 operator - () const { return Vec3(-v[0], -v[1], -v[2]); }
+};
+
+inline Vec3 min(const Vec3& a, const Vec3& b) { return Vec3(std::min(a.v[0], b.v[0]), std::min(a.v[1], b.v[1]), std::min(a.v[2], b.v[2])); }
+inline Vec3 max(const Vec3& a, const Vec3& b) { return Vec3(std::max(a.v[0], b.v[0]), std::max(a.v[1], b.v[1]), std::max(a.v[2], b.v[2])); }
+inline Vec3 rcp(const Vec3& a) { return Vec3(1.0f / a.v[0], 1.0f / a.v[1], 1.0f / a.v[2]); }
+inline float hmin(const Vec3& a) { return std::min(std::min(a.v[0], a.v[1]), a.v[2]); }
+inline float hmax(const Vec3& a) { return std::max(std::max(a.v[0], a.v[1]), a.v[2]); }
+inline float dot(const Vec3& a, const Vec3& b) { return a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2]; }
+
+inline Vec3 cross(const Vec3& a, const Vec3& b) {
+    return Vec3(a.v[1] * b.v[2] - a.v[2] * b.v[1], a.v[2] * b.v[0] - a.v[0] * b.v[2], a.v[0] * b.v[1] - a.v[1] * b.v[0]);
+}
+
+#endif
+
+#if defined(PT_SIMD_SSE)
+
+/// 4 floats, comparisons return lane masks
+struct Float4 {
+    static constexpr int Width = 4;
+    __m128 m;
+
+    Float4() { }
+    Float4(__m128 v) : m(v) { }
+    Float4(float v) : m(_mm_set1_ps(v)) { }
+
+    static Float4 load(const float* p) { return _mm_loadu_ps(p); }
+
+    void store(float* p) const { _mm_storeu_ps(p, m); }
+
+    Float4 operator + (const Float4& b) const { return _mm_add_ps(m, b.m); }
+    Float4 operator - (const Float4& b) const { return _mm_sub_ps(m, b.m); }
+    Float4 operator * (const Float4& b) const { return _mm_mul_ps(m, b.m); }
+    Float4 operator / (const Float4& b) const { return _mm_div_ps(m, b.m); }
+    Float4 operator & (const Float4& b) const { return _mm_and_ps(m, b.m); }
+    Float4 operator | (const Float4& b) const { return _mm_or_ps(m, b.m); }
+    Float4 operator < (const Float4& b) const { return _mm_cmplt_ps(m, b.m); }
+    Float4 operator <= (const Float4& b) const { return _mm_cmple_ps(m, b.m); }
+    Float4 operator > (const Float4& b) const { return _mm_cmpgt_ps(m, b.m); }
+    Float4 operator >= (const Float4& b) const { return _mm_cmpge_ps(m, b.m); }
+
+    // bit i is set when lane i of a mask is true
+    int mask() const { return _mm_movemask_ps(m); }
+
+    // first n lanes true
+    static Float4 firstLanes(int n) {
+        return _mm_castsi128_ps(_mm_cmplt_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(n)));
+    }
+};
+
+#if defined(__AVX2__)
+
+/// 8 floats, comparisons return lane masks
+struct Float8 {
+    static constexpr int Width = 8;
+    __m256 m;
+
+    Float8() { }
+    Float8(__m256 v) : m(v) { }
+    Float8(float v) : m(_mm256_set1_ps(v)) { }
+
+    static Float8 load(const float* p) { return _mm256_loadu_ps(p); }
+
+    void store(float* p) const { _mm256_storeu_ps(p, m); }
+
+    Float8 operator + (const Float8& b) const { return _mm256_add_ps(m, b.m); }
+    Float8 operator - (const Float8& b) const { return _mm256_sub_ps(m, b.m); }
+    Float8 operator * (const Float8& b) const { return _mm256_mul_ps(m, b.m); }
+    Float8 operator / (const Float8& b) const { return _mm256_div_ps(m, b.m); }
+    Float8 operator & (const Float8& b) const { return _mm256_and_ps(m, b.m); }
+    Float8 operator | (const Float8& b) const { return _mm256_or_ps(m, b.m); }
+    Float8 operator < (const Float8& b) const { return _mm256_cmp_ps(m, b.m, _CMP_LT_OQ); }
+    Float8 operator <= (const Float8& b) const { return _mm256_cmp_ps(m, b.m, _CMP_LE_OQ); }
+    Float8 operator > (const Float8& b) const { return _mm256_cmp_ps(m, b.m, _CMP_GT_OQ); }
+    Float8 operator >= (const Float8& b) const { return _mm256_cmp_ps(m, b.m, _CMP_GE_OQ); }
+
+    int mask() const { return _mm256_movemask_ps(m); }
+
+    static Float8 firstLanes(int n) {
+        return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+    }
+};
+
+#endif
+
+/// SoA pack of 3D vectors
+template <typename F>
+struct Vec3Pack {
+    F x, y, z;
+
+    Vec3Pack() { }
+    Vec3Pack(const F& x_, const F& y_, const F& z_) : x(x_), y(y_), z(z_) { }
+    Vec3Pack(const Vec3& v) : x(v.x()), y(v.y()), z(v.z()) { } // broadcast
+
+    Vec3Pack operator + (const Vec3Pack& b) const { return Vec3Pack(x + b.x, y + b.y, z + b.z); }
+    Vec3Pack operator - (const Vec3Pack& b) const { return Vec3Pack(x - b.x, y - b.y, z - b.z); }
+};
+
+template <typename F>
+inline F dot(const Vec3Pack<F>& a, const Vec3Pack<F>& b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+template <typename F>
+inline Vec3Pack<F> cross(const Vec3Pack<F>& a, const Vec3Pack<F>& b) {
+    return Vec3Pack<F>(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+typedef Vec3Pack<Float4> Vec3x4;
+#if defined(__AVX2__)
+typedef Vec3Pack<Float8> Vec3x8;
+typedef Float8 FloatPack; // widest pack
+#else
+typedef Float4 FloatPack;
+#endif
+
+#endif
+
+}
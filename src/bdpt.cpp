@@ -314,7 +314,7 @@ Vector3f BDPTIntegrator::Li(Scene* scene, Sampler* sampler, const Vector2f& pixe
 				auto ret = connectPathSampleCamera(scene, sampler, lightVertices, cameraVertices, s);
 				if (ret.has_value()) {
 					auto& [Lpath, pixel] = ret.value();
-					m_splatBlock->addSplat(pixel, Lpath);
+					m_splats.add(pixel, Lpath);
 				}
 			}
 			else if (s == 1) {// resample a point on a light and connect it to the camera subpath.
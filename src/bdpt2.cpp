@@ -34,7 +34,7 @@ void BDPTIntegrator2::connectCamera(const BDPTVertex& vertex, Camera* camera, Sc
 		float weight = (float)(1.0f / (1.0f + mis0));
 		radiance *= weight;
 	}
-	m_splatBlock->addSplat(pixel.value(), radiance);
+	m_splats.add(pixel.value(), radiance);
 }
 
 Vector3f BDPTIntegrator2::connectLight(const BDPTVertex& vertex, AreaLight* light, Scene* scene, Sampler* sampler) const {
@@ -50,17 +50,25 @@ Vector3f BDPTIntegrator2::connectLight(const BDPTVertex& vertex, AreaLight* ligh
 
 	Vector3f radiance(0.0);
 	if (
-		ls.pdfDir != 0.0f && ls.L.squaredNorm() != 0.0f &&
-		scene->unocculded(vertex.its.p, ls.p, vertex.its.ng, ls.n) // visibility test
-		) {
-		radiance = vertex.throughput
-			.cwiseProduct(vertex.its.BRDF(vertex.wi, ls.wi))
-			.cwiseProduct(ls.L / ls.pdfDir) * absDot(vertex.its.n, ls.wi);
-	}
+		ls.pdfDir == 0.0f || ls.L.squaredNorm() == 0.0f ||
+		!scene->unocculded(vertex.its.p, ls.p, vertex.its.ng, ls.n) // visibility test
+		)
+		return radiance;
+
+	// BRDF with its forward pdf, and the reverse pdf, in one batch
+	BSDF bsdf = vertex.its.getMaterial()->getBSDF(vertex.its, vertex.wi);
+	BSDF bsdfRev = bsdf.withOutgoing(ls.wi);
+	BSDFQuery queries[2] = { { &bsdf, ls.wi }, { &bsdfRev, vertex.wi } };
+	BRDFEval e[2];
+	BSDF::evalBatch(queries, e, 2);
+
+	radiance = vertex.throughput
+		.cwiseProduct(e[0].f)
+		.cwiseProduct(ls.L / ls.pdfDir) * absDot(vertex.its.n, ls.wi);
 
 	if (radiance.squaredNorm() != 0.0f) {
-		float eye_bsdf_pdfw = vertex.its.pdfBRDF(vertex.wi, ls.wi) * vertex.rr;
-		float eye_bsdf_rev_pdfw = vertex.its.pdfBRDF(ls.wi, vertex.wi) * vertex.rr;
+		float eye_bsdf_pdfw = e[0].pdf * vertex.rr;
+		float eye_bsdf_rev_pdfw = e[1].pdf * vertex.rr;
 
 		float emissionPdf = INV_TWOPI * ls.pdfArea;
 		double mis0 = MIS(eye_bsdf_pdfw / ls.pdfDir);
@@ -87,13 +95,26 @@ Vector3f BDPTIntegrator2::connectVertices(const BDPTVertex& p0, const BDPTVertex
 
 	float cosAtP0 = absDot(p0.its.n, n_delta);
 	float cosAtP1 = absDot(p1.its.n, n_delta);
-	const Vector3f g = p1.its.BRDF(p1.wi, n_delta).cwiseProduct(p0.its.BRDF(p0.wi, -n_delta)) * invDistcSqr;
+
+	// both BRDFs with their forward and reverse pdfs in one batch
+	BSDF bsdf0 = p0.its.getMaterial()->getBSDF(p0.its, p0.wi);
+	BSDF bsdf1 = p1.its.getMaterial()->getBSDF(p1.its, p1.wi);
+	BSDF bsdf0Rev = bsdf0.withOutgoing(-n_delta);
+	BSDF bsdf1Rev = bsdf1.withOutgoing(n_delta);
+	BSDFQuery queries[4] = {
+		{ &bsdf0, -n_delta }, { &bsdf1, n_delta },
+		{ &bsdf0Rev, p0.wi }, { &bsdf1Rev, p1.wi }
+	};
+	BRDFEval e[4];
+	BSDF::evalBatch(queries, e, 4);
+
+	const Vector3f g = e[1].f.cwiseProduct(e[0].f) * invDistcSqr;
 	if (g.squaredNorm() == 0.0f) return 0.0f;
 
-	float p0_bsdf_pdfw = p0.its.pdfBRDF(p0.wi, -n_delta) * p0.rr;
-	float p0_bsdf_rev_pdfw = p0.its.pdfBRDF(-n_delta, p0.wi) * p0.rr;
-	float p1_bsdf_pdfw = p1.its.pdfBRDF(p1.wi, n_delta) * p1.rr;
-	float p1_bsdf_rev_pdfw = p1.its.pdfBRDF(n_delta, p1.wi) * p1.rr;
+	float p0_bsdf_pdfw = e[0].pdf * p0.rr;
+	float p0_bsdf_rev_pdfw = e[2].pdf * p0.rr;
+	float p1_bsdf_pdfw = e[1].pdf * p1.rr;
+	float p1_bsdf_rev_pdfw = e[3].pdf * p1.rr;
 
 	float p0_a = p1_bsdf_pdfw * cosAtP0 * invDistcSqr;
 	float p1_a = p0_bsdf_pdfw * cosAtP1 * invDistcSqr;
@@ -5,6 +5,7 @@
 */
 
 #include <pt/bitmap.h>
+#include <pt/trace.h>
 #include <ImfInputFile.h>
 #include <ImfOutputFile.h>
 #include <ImfChannelList.h>
@@ -93,6 +94,7 @@ void Bitmap::load(const std::string &filename) {
 }
 
 void Bitmap::saveEXR(const std::string & path) {
+    PT_TRACE_SCOPE("Encode EXR", "output");
     cout << "Writing a " << cols() << "x" << rows()
          << " OpenEXR file to \"" << path << "\"" << endl;
 
@@ -120,6 +122,7 @@ void Bitmap::saveEXR(const std::string & path) {
 }
 
 void Bitmap::savePNG(const std::string & path, bool tonemap) {
+    PT_TRACE_SCOPE("Encode PNG", "output");
     cout << "Writing a " << cols() << "x" << rows()
          << " PNG file to \"" << path << "\"" << endl;
 
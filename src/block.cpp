@@ -23,21 +23,19 @@ ImageBlock::ImageBlock(const Vector2i &size, const Filter* filter) : m_offset(0,
         }
         m_filter[PT_FILTER_RESOLUTION] = 0.0f;
         m_lookupFactor = PT_FILTER_RESOLUTION / m_filterRadius;
-        int weightSize = (int)std::ceil(2 * m_filterRadius) + 1;
-        m_weightsX = new float[weightSize];
-        m_weightsY = new float[weightSize];
-        memset(m_weightsX, 0, sizeof(float) * weightSize);
-        memset(m_weightsY, 0, sizeof(float) * weightSize);
+        if ((int)std::ceil(2 * m_filterRadius) + 1 > MaxFilterWidth)
+            throw PathTracerException("Reconstruction filter radius is too large!");
     }
 
     /* Allocate space for pixels and border regions */
     resize(size.y() + 2 * m_borderSize, size.x() + 2 * m_borderSize);
+
+    m_rowLockCount = ((int)rows() + LockRows - 1) / LockRows;
+    m_rowLocks.reset(new tbb::spin_mutex[std::max(m_rowLockCount, 1)]);
 }
 
 ImageBlock::~ImageBlock() {
     delete[] m_filter;
-    delete[] m_weightsX;
-    delete[] m_weightsY;
 }
 
 //Bitmap *ImageBlock::toBitmap() const {
@@ -58,6 +56,10 @@ ImageBlock::~ImageBlock() {
 //}
 
 void ImageBlock::put(const Vector2f &globalPos, const Color3f &value, float weight) {
+    put(globalPos, value, weight, 0, int(rows()) - 1);
+}
+
+void ImageBlock::put(const Vector2f &globalPos, const Color3f &value, float weight, int firstRow, int lastRow) {
     //if (!value.isValid()) {
     //    /* If this happens, go fix your code instead of removing this warning ;) */
     //    cerr << "Integrator: computed an invalid radiance value: " << value.toString() << endl;
@@ -73,30 +75,63 @@ void ImageBlock::put(const Vector2f &globalPos, const Color3f &value, float weig
     localPos += Vector2f(m_borderSize);
     //coeffRef(localPos.y(), localPos.x()) += Color4f(value, weight);
 
+    /* Without a filter (filter importance sampling) the sample only goes to the pixel it lies in */
+    if (!m_filter) {
+        int y = int(localPos.y());
+        if (y >= firstRow && y <= lastRow)
+            coeffRef(y, int(localPos.x())) += Color4f(value, weight);
+        return;
+    }
+
     /* Compute the rectangle of pixels that will need to be updated */
     int boundMinX = std::max(int(std::ceil(localPos.x() - m_filterRadius)), 0);
-    int boundMinY = std::max(int(std::ceil(localPos.y() - m_filterRadius)), 0);
+    int boundMinY = std::max(int(std::ceil(localPos.y() - m_filterRadius)), firstRow);
     int boundMaxX = std::min(int(std::floor(localPos.x() + m_filterRadius)), int(cols() - 1));
-    int boundMaxY = std::min(int(std::floor(localPos.y() + m_filterRadius)), int(rows() - 1));
+    int boundMaxY = std::min(int(std::floor(localPos.y() + m_filterRadius)), lastRow);
 
-    /* Lookup values from the pre-rasterized filter */
+    /* Lookup values from the pre-rasterized filter (on the stack, put() may run concurrently) */
+    float weightsX[MaxFilterWidth], weightsY[MaxFilterWidth];
     for (int x = boundMinX, idx = 0; x <= boundMaxX; ++x, ++idx)
-        m_weightsX[idx] = m_filter[(int)(std::abs(x - localPos.x()) * m_lookupFactor)];
+        weightsX[idx] = m_filter[(int)(std::abs(x - localPos.x()) * m_lookupFactor)];
     for (int y = boundMinY, idx = 0; y <= boundMaxY; ++y, ++idx)
-        m_weightsY[idx] = m_filter[(int)(std::abs(y - localPos.y()) * m_lookupFactor)];
+        weightsY[idx] = m_filter[(int)(std::abs(y - localPos.y()) * m_lookupFactor)];
 
     for (int y = boundMinY, yr = 0; y <= boundMaxY; ++y, ++yr)
         for (int x = boundMinX, xr = 0; x <= boundMaxX; ++x, ++xr)
-            coeffRef(y, x) += Color4f(value, weight) * m_weightsX[xr] * m_weightsY[yr];
+            coeffRef(y, x) += Color4f(value, weight) * weightsX[xr] * weightsY[yr];
+}
+
+void ImageBlock::putPixel(const Vector2i& globalPixel, const Color3f& value, float weight) {
+    Vector2i localPixel = globalPixel - m_offset;
+    if (
+        localPixel.x() < 0 || localPixel.x() >= m_size.x() ||
+        localPixel.y() < 0 || localPixel.y() >= m_size.y()
+    ) return;
+
+    coeffRef(localPixel.y() + m_borderSize, localPixel.x() + m_borderSize) += Color4f(value, weight);
 }
 
 void ImageBlock::addSample(const Vector2f& globalPos, const Vector3f& value) {
     put(globalPos, Color3f(value.x(), value.y(), value.z()), 1.0f);
 }
 
+bool ImageBlock::footprintRows(const Vector2f& globalPos, int& first, int& last) const {
+    // rows of the filter footprint (in storage coordinates)
+    float y = globalPos.y() - m_offset.y() + m_borderSize;
+    first = m_filter ? int(std::ceil(y - m_filterRadius)) : int(std::floor(y));
+    last = m_filter ? int(std::floor(y + m_filterRadius)) : int(std::floor(y));
+    first = std::max(first, 0);
+    last = std::min(last, int(rows() - 1));
+    return first <= last;
+}
+
 void ImageBlock::addSplat(const Vector2f& globalPos, const Vector3f& value) {
-    tbb::mutex::scoped_lock lock(m_mutex);
+    int first, last;
+    if (!footprintRows(globalPos, first, last)) return;
+
+    lockRows(first, last);
     put(globalPos, Color3f(value.x(), value.y(), value.z()), 0.0f);
+    unlockRows(first, last);
 }
     
 void ImageBlock::put(ImageBlock &b) {
@@ -104,57 +139,265 @@ void ImageBlock::put(ImageBlock &b) {
         Vector2i::Constant(m_borderSize - b.getBorderSize());
     Vector2i size   = b.getSize()   + Vector2i(2*b.getBorderSize());
 
-    tbb::mutex::scoped_lock lock(m_mutex);
+    // merge stripe by stripe, only one lock is held at a time
+    for (int row = 0; row < size.y(); ) {
+        int stripe = (offset.y() + row) / LockRows;
+        int count = std::min((stripe + 1) * LockRows - (offset.y() + row), size.y() - row);
+
+        tbb::spin_mutex::scoped_lock lock(m_rowLocks[stripe]);
+        block(offset.y() + row, offset.x(), count, size.x()) += b.block(row, 0, count, size.x());
+        row += count;
+    }
+}
+
+void ImageBlock::snapshot(std::vector<Color4f>& pixels) const {
+    pixels.resize(size_t(rows()) * cols());
+    for (int stripe = 0; stripe < m_rowLockCount; stripe++) {
+        int first = stripe * LockRows;
+        int count = std::min(LockRows, int(rows()) - first);
+
+        tbb::spin_mutex::scoped_lock lock(m_rowLocks[stripe]);
+        std::copy(data() + size_t(first) * cols(), data() + size_t(first + count) * cols(),
+            pixels.begin() + size_t(first) * cols());
+    }
+}
+
+void ImageBlock::lockRows(int first, int last) const {
+    // always in increasing order, so holding several stripes cannot deadlock
+    for (int stripe = first / LockRows; stripe <= last / LockRows; stripe++)
+        m_rowLocks[stripe].lock();
+}
+
+void ImageBlock::unlockRows(int first, int last) const {
+    for (int stripe = last / LockRows; stripe >= first / LockRows; stripe--)
+        m_rowLocks[stripe].unlock();
+}
+
+void ImageBlock::lock() const {
+    if (rows() > 0) lockRows(0, int(rows()) - 1);
+}
+
+void ImageBlock::unlock() const {
+    if (rows() > 0) unlockRows(0, int(rows()) - 1);
+}
+
+void SplatBuffer::flush(std::vector<Splat>& queue) const {
+    constexpr int LockRows = ImageBlock::LockRows;
+    ImageBlock& target = *m_target;
+
+    // drop the splats outside of the target, sort the rest by the first row they touch
+    queue.erase(std::remove_if(queue.begin(), queue.end(), [&](Splat& splat) {
+        return !target.footprintRows(splat.pos, splat.firstRow, splat.lastRow);
+    }), queue.end());
+    if (queue.empty()) return;
+    std::sort(queue.begin(), queue.end(), [](const Splat& a, const Splat& b) { return a.firstRow < b.firstRow; });
+
+    int lastRow = 0;
+    for (const Splat& splat : queue)
+        lastRow = std::max(lastRow, splat.lastRow);
+
+    // lock every stripe once and put the rows of all splats overlapping it
+    size_t begin = 0;
+    for (int stripe = queue.front().firstRow / LockRows; stripe <= lastRow / LockRows; stripe++) {
+        int top = stripe * LockRows, bottom = top + LockRows - 1;
+        while (queue[begin].lastRow < top) begin++; // finished splats
+        size_t end = begin;
+        while (end < queue.size() && queue[end].firstRow <= bottom) end++;
+        if (end == begin) continue;
 
-    block(offset.y(), offset.x(), size.y(), size.x()) += b.topLeftCorner(size.y(), size.x());
+        tbb::spin_mutex::scoped_lock lock(target.m_rowLocks[stripe]);
+        for (size_t i = begin; i < end; i++) {
+            const Splat& splat = queue[i];
+            if (splat.lastRow < top) continue;
+            target.put(splat.pos, Color3f(splat.value.x(), splat.value.y(), splat.value.z()), 0.0f,
+                std::max(splat.firstRow, top), std::min(splat.lastRow, bottom));
+        }
+    }
+    queue.clear();
 }
 
 std::string ImageBlock::toString() const {
     return tfm::format("ImageBlock[offset=%s, size=%s]]", m_offset.toString(), m_size.toString());
 }
 
-BlockGenerator::BlockGenerator(const Vector2i &size, int blockSize) : m_size(size), m_blockSize(blockSize) {
+BlockGenerator::BlockGenerator(const Vector2i &size, int blockSize, Order order) : m_size(size), m_blockSize(blockSize) {
     m_numBlocks = Vector2i(
         (int) std::ceil(size.x() / (float) blockSize),
         (int) std::ceil(size.y() / (float) blockSize)
     );
-    m_blocksLeft = m_numBlocks.x() * m_numBlocks.y();
-    m_direction = ERight;
-    m_block = Vector2i((m_numBlocks - Vector2i(1)) / 2);
-    m_stepsLeft = 1;
-    m_numSteps = 1;
+    m_order.reserve(m_numBlocks.x() * m_numBlocks.y());
+
+    if (order == Order::Hilbert)
+        computeHilbertOrder();
+    else
+        computeSpiralOrder();
 }
 
-bool BlockGenerator::next(ImageBlock &block) {
-    tbb::mutex::scoped_lock lock(m_mutex);
+void BlockGenerator::computeSpiralOrder() {
+    int blocksLeft = m_numBlocks.x() * m_numBlocks.y();
+    int direction = ERight;
+    Vector2i block = Vector2i((m_numBlocks - Vector2i(1)) / 2);
+    int stepsLeft = 1;
+    int numSteps = 1;
 
-    if (m_blocksLeft == 0)
+    while (blocksLeft > 0) {
+        m_order.push_back(block.y() * m_numBlocks.x() + block.x());
+        if (--blocksLeft == 0)
+            break;
+
+        do {
+            switch (direction) {
+                case ERight: ++block.x(); break;
+                case EDown:  ++block.y(); break;
+                case ELeft:  --block.x(); break;
+                case EUp:    --block.y(); break;
+            }
+
+            if (--stepsLeft == 0) {
+                direction = (direction + 1) % 4;
+                if (direction == ELeft || direction == ERight) 
+                    ++numSteps;
+                stepsLeft = numSteps;
+            }
+        } while ((block.array() < 0).any() || (block.array() >= m_numBlocks.array()).any());
+    }
+}
+
+void BlockGenerator::computeHilbertOrder() {
+    int n = 1;
+    while (n < m_numBlocks.x() || n < m_numBlocks.y()) n <<= 1;
+
+    // distance along the Hilbert curve covering an n x n grid
+    auto hilbertIndex = [n](int x, int y) {
+        int64_t d = 0;
+        for (int s = n / 2; s > 0; s /= 2) {
+            int rx = (x & s) > 0;
+            int ry = (y & s) > 0;
+            d += int64_t(s) * s * ((3 * rx) ^ ry);
+            if (ry == 0) {
+                if (rx == 1) { x = s - 1 - x; y = s - 1 - y; }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    };
+
+    std::vector<std::pair<int64_t, int>> keys;
+    for (int y = 0; y < m_numBlocks.y(); ++y)
+        for (int x = 0; x < m_numBlocks.x(); ++x)
+            keys.emplace_back(hilbertIndex(x, y), y * m_numBlocks.x() + x);
+    std::sort(keys.begin(), keys.end());
+    for (const auto& key : keys)
+        m_order.push_back(key.second);
+}
+
+void BlockGenerator::setPriority(const std::vector<float>& priority) {
+    if (priority.size() != m_order.size())
+        throw PathTracerException("BlockGenerator: expected one priority per block!");
+    std::stable_sort(m_order.begin(), m_order.end(), [&](int a, int b) {
+        return priority[a] > priority[b];
+    });
+}
+
+bool BlockGenerator::next(Vector2i &offset, Vector2i &size) {
+    int i = m_next.fetch_add(1, std::memory_order_relaxed);
+    if (i >= int(m_order.size()))
+        return false;
+
+    int index = m_order[i];
+    offset = Vector2i(index % m_numBlocks.x(), index / m_numBlocks.x()) * m_blockSize;
+    size = (m_size - offset).cwiseMin(Vector2i::Constant(m_blockSize));
+    return true;
+}
+
+bool BlockGenerator::next(ImageBlock &block) {
+    Vector2i offset, size;
+    if (!next(offset, size))
         return false;
 
-    Vector2i pos = m_block * m_blockSize;
-    block.setOffset(pos);
-    block.setSize((m_size - pos).cwiseMin(Vector2i::Constant(m_blockSize)));
+    block.setOffset(offset);
+    block.setSize(size);
+    return true;
+}
+
+TileScheduler::TileScheduler(const Vector2i &size, int blockSize, const std::vector<float>& cost, int threadCount) {
+    BlockGenerator blocks(size, blockSize, BlockGenerator::Order::Hilbert);
+    if (int(cost.size()) != blocks.getBlockCount())
+        throw PathTracerException("TileScheduler: expected one cost per block!");
 
-    if (--m_blocksLeft == 0)
-        return true;
+    int numBlocksX = blocks.getBlockCounts().x();
+    double total = 0.0;
+    for (float c : cost) total += c;
+    float target = float(total / (std::max(threadCount, 1) * ItemsPerThread));
 
-    do {
-        switch (m_direction) {
-            case ERight: ++m_block.x(); break;
-            case EDown:  ++m_block.y(); break;
-            case ELeft:  --m_block.x(); break;
-            case EUp:    --m_block.y(); break;
+    WorkItem merged;
+    Vector2i offset, extent;
+    while (blocks.next(offset, extent)) {
+        float c = cost[(offset.y() / blockSize) * numBlocksX + offset.x() / blockSize];
+
+        // without a useful measurement every block is its own item
+        bool fits = target > 0.0f && merged.cost + c <= target;
+        if (!merged.blocks.empty() && !fits) {
+            m_items.push_back(std::move(merged));
+            merged = WorkItem();
         }
 
-        if (--m_stepsLeft == 0) {
-            m_direction = (m_direction + 1) % 4;
-            if (m_direction == ELeft || m_direction == ERight) 
-                ++m_numSteps;
-            m_stepsLeft = m_numSteps;
+        if (target > 0.0f && c > 2.0f * target) {
+            split(offset, extent, c, target);
+            continue;
         }
-    } while ((m_block.array() < 0).any() || (m_block.array() >= m_numBlocks.array()).any());
+        merged.blocks.emplace_back(offset, extent);
+        merged.cost += c;
+    }
+    if (!merged.blocks.empty())
+        m_items.push_back(std::move(merged));
 
-    return true;
+    // longest processing time first
+    std::stable_sort(m_items.begin(), m_items.end(), [](const WorkItem& a, const WorkItem& b) {
+        return a.cost > b.cost;
+    });
+}
+
+void TileScheduler::split(const Vector2i &offset, const Vector2i &size, float cost, float target) {
+    Vector2i half = size / 2;
+    if (cost <= target || half.x() < MinBlockSize || half.y() < MinBlockSize) {
+        WorkItem item;
+        item.blocks.emplace_back(offset, size);
+        item.cost = cost;
+        m_items.push_back(std::move(item));
+        return;
+    }
+
+    // the cost is assumed to be spread evenly over the block
+    float area = float(size.prod());
+    for (int i = 0; i < 4; ++i) {
+        Vector2i subOffset(i & 1 ? half.x() : 0, i & 2 ? half.y() : 0);
+        Vector2i subSize(i & 1 ? size.x() - half.x() : half.x(), i & 2 ? size.y() - half.y() : half.y());
+        split(offset + subOffset, subSize, cost * subSize.prod() / area, target);
+    }
+}
+
+const TileScheduler::WorkItem* TileScheduler::next() {
+    int i = m_next.fetch_add(1, std::memory_order_relaxed);
+    return i < int(m_items.size()) ? &m_items[i] : nullptr;
+}
+
+std::string TileScheduler::toString() const {
+    size_t blocks = 0;
+    float maxCost = 0.0f;
+    for (const WorkItem& item : m_items) {
+        blocks += item.blocks.size();
+        maxCost = std::max(maxCost, item.cost);
+    }
+
+    return tfm::format(
+        "TileScheduler[\n"
+        "  items = %i,\n"
+        "  blocks = %i,\n"
+        "  maxCost = %f\n"
+        "]",
+        m_items.size(), blocks, maxCost
+    );
 }
 
 }
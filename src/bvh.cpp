@@ -1,5 +1,6 @@
 #include <numeric> 
 #include <stack>
+#include <memory>
 
 #include <pt/ray.h>
 #include <pt/aabb.h>
@@ -7,6 +8,7 @@
 #include <pt/mesh.h>
 #include <pt/bvh.h>
 #include <pt/timer.h>
+#include <pt/stats.h>
 
 namespace pt {
 
@@ -21,21 +23,130 @@ void BVHTree::build() {
 
     BVHTreeBuilder builder(this);
     builder.build(prim_aabbs, prim_centers);
+    packLeaves();
 }
 
+void BVHTree::packLeaves() {
+    // children are always stored after their parent
+    std::vector<size_t> depth(m_nodes.size(), 0);
+    m_depth = 0;
+    for (size_t i = 0; i < m_nodes.size(); i++) {
+        m_depth = std::max(m_depth, depth[i]);
+        if (!m_nodes[i].isLeaf())
+            depth[m_nodes[i].first_id] = depth[m_nodes[i].first_id + 1] = depth[i] + 1;
+    }
+
+#if defined(PT_SIMD_SSE)
+    // padded so a full pack can be loaded at the last leaf
+    size_t count = m_prim_ids.size();
+    for (auto& values : m_leaf_tris) values.assign(count + FloatPack::Width, 0.0f);
+    for (size_t i = 0; i < count; i++) {
+        Vector3f p0, p1, p2;
+        (*m_shapes)[m_prim_ids[i]]->getVertex(p0, p1, p2);
+        Vector3f edge1 = p1 - p0, edge2 = p2 - p0;
+        for (int axis = 0; axis < 3; axis++) {
+            m_leaf_tris[0 + axis][i] = p0[axis];
+            m_leaf_tris[3 + axis][i] = edge1[axis];
+            m_leaf_tris[6 + axis][i] = edge2[axis];
+        }
+    }
+#endif
+}
+
+#if defined(PT_SIMD_SSE)
+
+/**
+ * Moller-Trumbore against count packed triangles starting at first, with the
+ * same tests as Triangle::intersect. Returns the offset of the closest hit
+ * (max_dis, u and v are updated), or -1. With any_hit the first hit is
+ * returned.
+ */
+template <typename F>
+static inline int intersectLeaf(
+    const std::vector<float>* tris, size_t first, int count,
+    const Vec3Pack<F>& org, const Vec3Pack<F>& dir,
+    float min_dis, float& max_dis, float& u, float& v, bool any_hit
+) {
+    int hit = -1;
+    for (int base = 0; base < count; base += F::Width) {
+        size_t i = first + base;
+        Vec3Pack<F> p0(F::load(&tris[0][i]), F::load(&tris[1][i]), F::load(&tris[2][i]));
+        Vec3Pack<F> edge1(F::load(&tris[3][i]), F::load(&tris[4][i]), F::load(&tris[5][i]));
+        Vec3Pack<F> edge2(F::load(&tris[6][i]), F::load(&tris[7][i]), F::load(&tris[8][i]));
+
+        Vec3Pack<F> pvec = cross(dir, edge2);
+        F det = dot(edge1, pvec);
+        F valid = F::firstLanes(count - base) & ((det <= F(-1e-5f)) | (det >= F(1e-5f)));
+        F inv_det = F(1.0f) / det;
+
+        Vec3Pack<F> tvec = org - p0;
+        F uu = dot(tvec, pvec) * inv_det;
+        valid = valid & (uu >= F(0.0f)) & (uu <= F(1.0f));
+
+        Vec3Pack<F> qvec = cross(tvec, edge1);
+        F vv = dot(dir, qvec) * inv_det;
+        valid = valid & (vv >= F(0.0f)) & (uu + vv <= F(1.0f));
+
+        F t = dot(edge2, qvec) * inv_det;
+        valid = valid & (t >= F(min_dis)) & (t <= F(max_dis));
+
+        int mask = valid.mask();
+        if (mask == 0) continue;
+
+        alignas(32) float ts[F::Width], us[F::Width], vs[F::Width];
+        t.store(ts); uu.store(us); vv.store(vs);
+        for (int lane = 0; lane < F::Width; lane++) {
+            if (!(mask & (1 << lane)) || ts[lane] > max_dis) continue;
+            max_dis = ts[lane]; u = us[lane]; v = vs[lane];
+            hit = base + lane;
+            if (any_hit) return hit;
+        }
+    }
+    return hit;
+}
+
+#endif
+
+PT_STAT_DISTRIBUTION(statClosestNodes, "BVH", "Nodes visited per closest-hit ray");
+PT_STAT_DISTRIBUTION(statClosestTriangles, "BVH", "Triangles tested per closest-hit ray");
+PT_STAT_DISTRIBUTION(statShadowNodes, "BVH", "Nodes visited per shadow ray");
+PT_STAT_DISTRIBUTION(statShadowTriangles, "BVH", "Triangles tested per shadow ray");
+
 bool BVHTree::rayIntersect(const Ray& ray_, Intersection& its) {
     bool intersect = false;
+    PT_STATS_ONLY(int64_t nodesVisited = 0, trianglesTested = 0;)
 
 	Ray ray(ray_);
-    std::vector<size_t> stack;
-    stack.push_back(0);
+    Vec3 org(ray.org), inv_dir = rcp(Vec3(ray.dir));
+#if defined(PT_SIMD_SSE)
+    Vec3Pack<FloatPack> org_pack(org), dir_pack(Vec3(ray.dir));
+#endif
+
+    size_t local_stack[StackSize];
+    std::unique_ptr<size_t[]> heap_stack;
+    size_t* stack = local_stack;
+    if (m_depth >= StackSize) {
+        heap_stack.reset(new size_t[m_depth + 1]);
+        stack = heap_stack.get();
+    }
+    size_t top = 0;
+    stack[top++] = 0;
 
-    while (!stack.empty()) {
-        size_t node_idx = stack.back();
-        stack.pop_back();
-        const Node& node = m_nodes[node_idx];
+    while (top > 0) {
+        const Node& node = m_nodes[stack[--top]];
+        PT_STATS_ONLY(nodesVisited++;)
 
         if (node.isLeaf()) {
+            PT_STATS_ONLY(trianglesTested += node.prim_count;)
+#if defined(PT_SIMD_SSE)
+            float u, v;
+            int hit = intersectLeaf(m_leaf_tris, node.first_id, int(node.prim_count),
+                org_pack, dir_pack, ray.min_dis, ray.max_dis, u, v, false);
+            if (hit >= 0) {
+                intersect = true;
+                its.setInfo((*m_shapes)[m_prim_ids[node.first_id + hit]], Vector3f(1.0f - u - v, u, v));
+            }
+#else
             for (size_t prim_idx = node.first_id, i = 0; i < node.prim_count; prim_idx++, i++) {
                 Triangle* primitive = (*m_shapes) [m_prim_ids[prim_idx]];
                 Vector3f bary; float t;
@@ -45,43 +156,73 @@ bool BVHTree::rayIntersect(const Ray& ray_, Intersection& its) {
 					its.setInfo(primitive, bary);
 				}
             }
+#endif
         }
         else {
-            if (node.aabb.intersect(ray)) {
-                stack.push_back(node.first_id);
-                stack.push_back(node.first_id + 1);
+            if (node.aabb.intersect(org, inv_dir, ray.min_dis, ray.max_dis)) {
+                stack[top++] = node.first_id;
+                stack[top++] = node.first_id + 1;
             }
         }
     }
 
+    PT_STAT_SAMPLE(statClosestNodes, nodesVisited);
+    PT_STAT_SAMPLE(statClosestTriangles, trianglesTested);
     if (intersect) its.complete();
     return intersect;
 }
 
 bool BVHTree::rayIntersect(const Ray& ray) {
-    std::vector<size_t> stack;
-    stack.push_back(0);
+    PT_STATS_ONLY(int64_t nodesVisited = 0, trianglesTested = 0;)
+    Vec3 org(ray.org), inv_dir = rcp(Vec3(ray.dir));
+#if defined(PT_SIMD_SSE)
+    Vec3Pack<FloatPack> org_pack(org), dir_pack(Vec3(ray.dir));
+#endif
+
+    size_t local_stack[StackSize];
+    std::unique_ptr<size_t[]> heap_stack;
+    size_t* stack = local_stack;
+    if (m_depth >= StackSize) {
+        heap_stack.reset(new size_t[m_depth + 1]);
+        stack = heap_stack.get();
+    }
+    size_t top = 0;
+    stack[top++] = 0;
 
-    while (!stack.empty()) {
-        size_t node_idx = stack.back();
-        stack.pop_back();
-        const Node& node = m_nodes[node_idx];
+    while (top > 0) {
+        const Node& node = m_nodes[stack[--top]];
+        PT_STATS_ONLY(nodesVisited++;)
 
         if (node.isLeaf()) {
-            for (size_t prim_idx = node.first_id, i = 0; i < node.prim_count; prim_idx++, i++) {
+            PT_STATS_ONLY(trianglesTested += node.prim_count;)
+            bool hit = false;
+#if defined(PT_SIMD_SSE)
+            float max_dis = ray.max_dis, u, v;
+            hit = intersectLeaf(m_leaf_tris, node.first_id, int(node.prim_count),
+                org_pack, dir_pack, ray.min_dis, max_dis, u, v, true) >= 0;
+#else
+            for (size_t prim_idx = node.first_id, i = 0; i < node.prim_count && !hit; prim_idx++, i++) {
                 Triangle* primitive = (*m_shapes)[m_prim_ids[prim_idx]];
                 Vector3f bary; float t;
-                if (primitive->intersect(ray, bary, t)) return true;
+                hit = primitive->intersect(ray, bary, t);
+            }
+#endif
+            if (hit) {
+                PT_STAT_SAMPLE(statShadowNodes, nodesVisited);
+                PT_STAT_SAMPLE(statShadowTriangles, trianglesTested);
+                return true;
             }
         }
         else {
-            if (node.aabb.intersect(ray)) {
-                stack.push_back(node.first_id);
-                stack.push_back(node.first_id + 1);
+            if (node.aabb.intersect(org, inv_dir, ray.min_dis, ray.max_dis)) {
+                stack[top++] = node.first_id;
+                stack[top++] = node.first_id + 1;
             }
         }
     }
 
+    PT_STAT_SAMPLE(statShadowNodes, nodesVisited);
+    PT_STAT_SAMPLE(statShadowTriangles, trianglesTested);
     return false;
 }
 
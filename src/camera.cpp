@@ -88,6 +88,16 @@ Ray Camera::sampleRay(const Vector2f screen_pos) {
 	return Ray(m_eye, d, Camera::cnear * proj, Camera::cfar * proj);
 }
 
+RayDifferential Camera::sampleRayDifferential(const Vector2f screen_pos) {
+	RayDifferential ray(sampleRay(screen_pos));
+	Ray rx = sampleRay(screen_pos + Vector2f(1.0f, 0.0f));
+	Ray ry = sampleRay(screen_pos + Vector2f(0.0f, 1.0f));
+	ray.rxOrg = rx.org; ray.rxDir = rx.dir;
+	ray.ryOrg = ry.org; ray.ryDir = ry.dir;
+	ray.hasDifferentials = true;
+	return ray;
+}
+
 std::optional<Vector2f> Camera::project(const Vector3f& p) {
 	Vector3f p_cam = m_world2camera.apply(p, Transform::Type::Scaler);
 	Vector3f p_ndc = m_camera2sample.apply(p_cam, Transform::Type::Scaler);
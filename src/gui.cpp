@@ -108,20 +108,20 @@ GUI::GUI(const ImageBlock& sampleBlock, const ImageBlock& splatBlock) :
     m_shader->set_uniform("borderSize", borderSize);
     
     // Allocate texture memory for the rendered image
-    m_sampleTexture = new Texture(
-        Texture::PixelFormat::RGBA,
-        Texture::ComponentFormat::Float32,
+    m_sampleTexture = new nanogui::Texture(
+        nanogui::Texture::PixelFormat::RGBA,
+        nanogui::Texture::ComponentFormat::Float32,
         nanogui::Vector2i(size.x() + 2 * borderSize, size.y() + 2 * borderSize),
-        Texture::InterpolationMode::Nearest,
-        Texture::InterpolationMode::Nearest
+        nanogui::Texture::InterpolationMode::Nearest,
+        nanogui::Texture::InterpolationMode::Nearest
     );
 
-    m_splatTexture = new Texture(
-        Texture::PixelFormat::RGBA,
-        Texture::ComponentFormat::Float32,
+    m_splatTexture = new nanogui::Texture(
+        nanogui::Texture::PixelFormat::RGBA,
+        nanogui::Texture::ComponentFormat::Float32,
         nanogui::Vector2i(size.x() + 2 * borderSize, size.y() + 2 * borderSize),
-        Texture::InterpolationMode::Nearest,
-        Texture::InterpolationMode::Nearest
+        nanogui::Texture::InterpolationMode::Nearest,
+        nanogui::Texture::InterpolationMode::Nearest
     );
 
     draw_all();
@@ -133,9 +133,10 @@ GUI::GUI(const ImageBlock& sampleBlock, const ImageBlock& splatBlock) :
 
 
 void GUI::draw_contents() {
-    // Reload the partially rendered image onto the GPU
-    m_sampleBlock.lock();
-    m_splatBlock.lock();
+    // Reload the partially rendered image onto the GPU, the films are copied
+    // stripe by stripe so render threads are only blocked for a few rows
+    m_sampleBlock.snapshot(m_samplePixels);
+    m_splatBlock.snapshot(m_splatPixels);
 
     const Vector2i &size = m_sampleBlock.getSize();
     m_shader->set_uniform("tonemapScale", m_tonemapScale);
@@ -147,8 +148,8 @@ void GUI::draw_contents() {
         nanogui::Vector2i(m_pixel_ratio * size[0], m_pixel_ratio * size[1])
     );
 
-    m_sampleTexture->upload((uint8_t *)m_sampleBlock.data());
-    m_splatTexture->upload((uint8_t*)m_splatBlock.data());
+    m_sampleTexture->upload((uint8_t *)m_samplePixels.data());
+    m_splatTexture->upload((uint8_t*)m_splatPixels.data());
     m_shader->set_texture("sampleTexture", m_sampleTexture);
     m_shader->set_texture("splatTexture", m_splatTexture);
 
@@ -157,9 +158,6 @@ void GUI::draw_contents() {
     m_shader->end();
     // m_renderPass->set_viewport(nanogui::Vector2i(0, 0), framebuffer_size());
     m_renderPass->end();
-
-    m_sampleBlock.unlock();
-    m_splatBlock.unlock();
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include <pt/heatmap.h>
+#include <pt/bitmap.h>
+#include <tbb/task_arena.h>
+#include <fstream>
+
+namespace pt {
+
+// inferno-like color ramp, t in [0, 1]
+static Color3f heatColor(float t) {
+    static const Color3f stops[] = {
+        Color3f(0.0f, 0.0f, 0.02f), Color3f(0.34f, 0.06f, 0.43f), Color3f(0.85f, 0.26f, 0.31f),
+        Color3f(0.99f, 0.65f, 0.04f), Color3f(0.99f, 1.0f, 0.64f)
+    };
+    constexpr int last = sizeof(stops) / sizeof(stops[0]) - 1;
+
+    float x = std::clamp(t, 0.0f, 1.0f) * last;
+    int i = std::min(int(x), last - 1);
+    return mix(stops[i], stops[i + 1], x - i);
+}
+
+CostHeatmap::CostHeatmap(const Vector2i& size, bool perPixel) : m_size(size), m_perPixel(perPixel) {
+    m_pixels.assign(size_t(size.x()) * size.y(), 0.0f);
+}
+
+void CostHeatmap::clear() {
+    std::fill(m_pixels.begin(), m_pixels.end(), 0.0f);
+    m_blocks.clear();
+}
+
+void CostHeatmap::addBlock(const Vector2i& offset, const Vector2i& size, float seconds) {
+    m_blocks.push_back(BlockRecord{ offset, size, seconds, tbb::this_task_arena::current_thread_index() });
+    if (m_perPixel)
+        return;
+
+    float perPixel = seconds / size.prod();
+    for (int y = 0; y < size.y(); ++y)
+        for (int x = 0; x < size.x(); ++x)
+            addPixel(offset + Vector2i(x, y), perPixel);
+}
+
+void CostHeatmap::save(const std::string& prefix) const {
+    Bitmap seconds(m_size), colors(m_size);
+
+    // the PNG maps the log of the time, the range is taken from the non-zero pixels
+    float minTime = std::numeric_limits<float>::infinity(), maxTime = 0.0f;
+    for (float t : m_pixels) {
+        if (t > 0.0f) minTime = std::min(minTime, t);
+        maxTime = std::max(maxTime, t);
+    }
+    float logMin = maxTime > 0.0f ? std::log(minTime) : 0.0f;
+    float logRange = maxTime > minTime ? std::log(maxTime) - logMin : 1.0f;
+
+    for (int y = 0; y < m_size.y(); ++y) {
+        for (int x = 0; x < m_size.x(); ++x) {
+            float t = m_pixels[size_t(y) * m_size.x() + x];
+            seconds.coeffRef(y, x) = Color3f(t);
+            colors.coeffRef(y, x) = t > 0.0f ? heatColor((std::log(t) - logMin) / logRange) : heatColor(0.0f);
+        }
+    }
+    seconds.saveEXR(prefix + ".exr");
+    colors.savePNG(prefix + ".png", false);
+
+    std::string csvPath = prefix + ".csv";
+    cout << "Writing " << m_blocks.size() << " block times to \"" << csvPath << "\"" << endl;
+    std::ofstream csv(csvPath);
+    if (!csv) {
+        cout << "CostHeatmap::save(): Could not save CSV file \"" << csvPath << "\"" << endl;
+        return;
+    }
+    csv << "x,y,width,height,seconds,thread\n";
+    for (const BlockRecord& block : m_blocks)
+        csv << block.offset.x() << "," << block.offset.y() << "," << block.size.x() << "," << block.size.y()
+            << "," << block.seconds << "," << block.thread << "\n";
+}
+
+std::string CostHeatmap::toString() const {
+    double total = 0.0;
+    float maxBlock = 0.0f;
+    for (const BlockRecord& block : m_blocks) {
+        total += block.seconds;
+        maxBlock = std::max(maxBlock, block.seconds);
+    }
+
+    return tfm::format(
+        "CostHeatmap[\n"
+        "  blocks = %i,\n"
+        "  total = %.3fs,\n"
+        "  slowest block = %.3fs,\n"
+        "  per pixel = %s\n"
+        "]",
+        m_blocks.size(), total, maxBlock, m_perPixel ? "true" : "false"
+    );
+}
+
+}
@@ -9,6 +9,7 @@
 #include <pt/sampler.h>
 #include <pt/light.h>
 #include <pt/camera.h>
+#include <pt/stats.h>
 	
 namespace pt {
 
@@ -17,6 +18,16 @@ inline float powerHeuristic(float f, float g) {
 	return f2 / (f2 + g2);
 }
 
+inline float luminance(const Vector3f& c) {
+	return c.x() * 0.212671f + c.y() * 0.715160f + c.z() * 0.072169f;
+}
+
+inline uint32_t floatBits(float f) {
+	uint32_t bits;
+	std::memcpy(&bits, &f, sizeof(uint32_t));
+	return bits;
+}
+
 Vector3f GeometryIntegrator::Li(Scene* scene, Sampler* sampler, const Vector2f& pixelSample) {
 	Ray ray = scene->getCamera()->sampleRay(pixelSample);
 	Intersection its;
@@ -31,26 +42,43 @@ Vector3f GeometryIntegrator::Li(Scene* scene, Sampler* sampler, const Vector2f&
 }
 
 Vector3f BaseColorIntegrator::Li(Scene* scene, Sampler* sampler, const Vector2f& pixelSample) {
-	Ray ray = scene->getCamera()->sampleRay(pixelSample);
+	RayDifferential ray = scene->getCamera()->sampleRayDifferential(pixelSample);
+	ray.scaleDifferentials(1.0f / std::sqrt(float(sampler->getSPP())));
 	Intersection its;
 	bool hit = scene->rayIntersect(ray, its);
 	if (hit) {
-		Vector3f c = its.getMaterial()->getBaseColor(its.uv);
+		its.computeDifferentials(ray);
+		Vector3f c = its.getMaterial()->getBaseColor(its);
 		return c;
 	}
 	else
 		return Vector3f(0);
 }
 
-Vector3f PathIntegrator::Li(Scene* scene, Sampler* sampler, const Vector2f& pixelSample) {
-	Ray ray = scene->getCamera()->sampleRay(pixelSample);
+PT_STAT_HISTOGRAM(statPathLength, "Integrator", "Path length (surface hits)");
+PT_STAT_RATIO(statRussianRoulette, "Integrator", "Paths terminated by Russian roulette");
+
+template <typename SamplerT>
+Vector3f PathIntegrator::Li(Scene* scene, SamplerT* sampler, const Vector2f& pixelSample) {
+	// texture footprint is only tracked for camera rays, deeper bounces use the finest level
+	RayDifferential cameraRay = scene->getCamera()->sampleRayDifferential(pixelSample);
+	cameraRay.scaleDifferentials(1.0f / std::sqrt(float(sampler->getSPP())));
+	Ray ray = cameraRay;
+	bool cameraHit = true;
 	Vector3f L(0.0), accThroughput(1.0);
 	float brdfPdf;
+	Vector3f prevP, prevN; // previous shading point, the light selection may depend on it
+	PT_STATS_ONLY(int64_t pathLength = 0; bool rouletteKilled = false;)
 
 	for(int bounce = 0; bounce < 32; bounce++) {
 		Intersection its;
 		bool hit = scene->rayIntersect(ray, its);
 		if (!hit) break;
+		PT_STATS_ONLY(pathLength++;)
+		if (cameraHit) {
+			its.computeDifferentials(cameraRay);
+			cameraHit = false;
+		}
 
 		Vector3f wo = -ray.dir;
 
@@ -61,15 +89,18 @@ Vector3f PathIntegrator::Li(Scene* scene, Sampler* sampler, const Vector2f& pixe
 			if (bounce == 0) L += accThroughput.cwiseProduct(Le);
 			else {
 				float light_pdf = light->pdfLi(its, ray);
-				light_pdf *= scene->getLightSelector()->pdf(light); // select pdf
+				light_pdf *= scene->getLightSelector()->pdf(light, prevP, prevN); // select pdf
 				float misWeight = powerHeuristic(brdfPdf, light_pdf);
 				//misWeight = 1.0;
 				L += misWeight * accThroughput.cwiseProduct(Le); // brdf mis
 			}
 		}
 
+		// texture, lobe weights and reflected direction are resolved once per hit
+		BSDF bsdf = scene->getMaterialTable().getBSDF(its, wo);
+
 		// sample light
-		Vector3f Ld = sampleLd(scene, sampler, its, wo);
+		Vector3f Ld = sampleLd(scene, sampler, its, bsdf);
 		L += accThroughput.cwiseProduct(Ld);
 
 		//BRDFSample bs; // code to sample hemisphere not BRDF
@@ -80,7 +111,7 @@ Vector3f PathIntegrator::Li(Scene* scene, Sampler* sampler, const Vector2f& pixe
 		//bs.f = its.BRDF(wo, bs.wi);
 
 		// sample BRDF
-		BRDFSample bs = its.sampleBRDF(wo, sampler->sample1D(), sampler->sample2D());
+		BRDFSample bs = bsdf.sample(sampler->sample1D(), sampler->sample2D());
 		if (bs.specular) {
 			bounce--; // assume no energy loss (not right)
 			brdfPdf = 1.0;
@@ -94,27 +125,39 @@ Vector3f PathIntegrator::Li(Scene* scene, Sampler* sampler, const Vector2f& pixe
 
 		// new ray
 		ray = its.genRay(bs.wi);
+		prevP = its.p;
+		prevN = its.n;
 
 		// possibly terminate the path with Russian roulette
 		if (accThroughput.maxCoeff() < 1.0f && bounce > 1) {
 			float q = std::max(0.0f, 1.0f - accThroughput.maxCoeff());
-			if (sampler->sample1D() < q) break;
+			if (sampler->sample1D() < q) {
+				PT_STATS_ONLY(rouletteKilled = true;)
+				break;
+			}
 			accThroughput /= (1.0f - q);
 		}
 	}
 
+	PT_STAT_SAMPLE(statPathLength, pathLength);
+	PT_STAT_RATIO_ADD(statRussianRoulette, rouletteKilled ? 1 : 0, 1);
 	return L;
 }
 
-Vector3f PathIntegrator::sampleLd(Scene* scene, Sampler* sampler, const Intersection& surfIts, const Vector3f& wo) const {
+template <typename SamplerT>
+Vector3f PathIntegrator::sampleLd(Scene* scene, SamplerT* sampler, const Intersection& surfIts, const BSDF& bsdf) const {
+	if (m_risCandidates > 1)
+		return sampleLdRIS(scene, sampler, surfIts, bsdf);
+
 	const std::vector<AreaLight*>& lights = scene->getLights();
 	int nLights = lights.size();
 	if (lights.empty())
 		return Vector3f(0.0);
 
-	// uniformly select a light source
-	AreaLight* light = scene->getLightSelector()->select(sampler->sample1D());
-	float selectPdf = scene->getLightSelector()->pdf(light);
+	// select a light source
+	LightSelector* selector = scene->getLightSelector();
+	AreaLight* light = selector->select(sampler->sample1D(), surfIts.p, surfIts.n);
+	float selectPdf = selector->pdf(light, surfIts.p, surfIts.n);
 
 	// sample a point on the light source (sample a triangle)
 	LightLiSample lightIts = light->sampleLi(surfIts, sampler->sample2D());
@@ -128,11 +171,13 @@ Vector3f PathIntegrator::sampleLd(Scene* scene, Sampler* sampler, const Intersec
 	Vector3f& Le = lightIts.L;
 
 	// phong BRDF
-	Vector3f f = surfIts.BRDF(wo, wi);
+	BRDFEval brdf = bsdf.eval(wi);
+	Vector3f& f = brdf.f;
 	float cosTheta = surfIts.n.dot(wi);
+	selector->record(light, surfIts.p, surfIts.n, luminance(f.cwiseProduct(Le)) * cosTheta / (lightIts.pdfDir * selectPdf));
 
 	// light mis
-	float brdf_pdf = surfIts.pdfBRDF(wo, wi);
+	float brdf_pdf = brdf.pdf;
 	float light_pdf = lightIts.pdfDir * selectPdf;
 	float misWeight = powerHeuristic(light_pdf, brdf_pdf);
 	//misWeight = 1.0;
@@ -140,4 +185,81 @@ Vector3f PathIntegrator::sampleLd(Scene* scene, Sampler* sampler, const Intersec
 	return misWeight * f.cwiseProduct(Le) * cosTheta / light_pdf;
 }
 
-}
\ No newline at end of file
+template <typename SamplerT>
+Vector3f PathIntegrator::sampleLdRIS(Scene* scene, SamplerT* sampler, const Intersection& surfIts, const BSDF& bsdf) const {
+	/**
+	* Talbot, J., Cline, D. and Egbert, P. (2005). Importance Resampling for Global Illumination.
+	* Bitterli, B. et al. (2020). Spatiotemporal reservoir resampling for real-time ray tracing with dynamic direct lighting.
+	*/
+	if (scene->getLights().empty())
+		return Vector3f(0.0);
+
+	struct Candidate {
+		AreaLight* light;
+		LightLiSample ls;
+		BRDFEval brdf;
+		float lightPdf;
+		float targetPdf;
+	};
+
+	// candidates are cheap (no shadow ray), draw them from a local stream seeded by the sampler
+	Vector2f seed = sampler->sample2D();
+	pcg32 rng(floatBits(seed.x()), floatBits(seed.y()));
+
+	LightSelector* selector = scene->getLightSelector();
+	Reservoir<Candidate> reservoir;
+	float u = sampler->sample1D();
+
+	// candidates are generated in batches so their BRDFs are evaluated together
+	constexpr int BatchSize = 8;
+	Candidate batch[BatchSize];
+	Vector3f wi[BatchSize];
+	BRDFEval brdf[BatchSize];
+	for (int start = 0; start < m_risCandidates; start += BatchSize) {
+		int n = std::min(m_risCandidates - start, BatchSize), valid = 0;
+		for (int i = 0; i < n; i++) {
+			AreaLight* light = selector->select(rng.nextFloat(), surfIts.p, surfIts.n);
+			float selectPdf = selector->pdf(light, surfIts.p, surfIts.n);
+
+			LightLiSample ls = light->sampleLi(surfIts, Vector2f(rng.nextFloat(), rng.nextFloat()));
+			if (ls.pdfDir == 0.0f) {
+				reservoir.count++;
+				continue;
+			}
+			batch[valid] = Candidate { light, ls, BRDFEval(), ls.pdfDir * selectPdf, 0.0f };
+			wi[valid++] = ls.wi;
+		}
+
+		// unshadowed contribution as target function
+		bsdf.eval(wi, brdf, valid);
+		for (int i = 0; i < valid; i++) {
+			Candidate& c = batch[i];
+			c.brdf = brdf[i];
+			c.targetPdf = luminance(c.brdf.f.cwiseProduct(c.ls.L)) * surfIts.n.dot(c.ls.wi);
+			reservoir.update(c, c.targetPdf / c.lightPdf, u);
+		}
+	}
+
+	if (reservoir.empty())
+		return Vector3f(0.0);
+	const Candidate& c = reservoir.sample;
+
+	// visibility test (only once)
+	if (!scene->unocculded(surfIts.p, c.ls.p, surfIts.n, c.ls.n))
+		return Vector3f(0.0);
+
+	// light mis, the weights still sum up to one with BRDF sampling
+	float misWeight = powerHeuristic(c.lightPdf, c.brdf.pdf);
+
+	float risWeight = reservoir.weightSum / (reservoir.count * c.targetPdf);
+	selector->record(c.light, surfIts.p, surfIts.n, c.targetPdf * risWeight);
+	return misWeight * c.brdf.f.cwiseProduct(c.ls.L) * surfIts.n.dot(c.ls.wi) * risWeight;
+}
+
+template Vector3f PathIntegrator::Li<Sampler>(Scene*, Sampler*, const Vector2f&);
+template Vector3f PathIntegrator::Li<IndependentSampler>(Scene*, IndependentSampler*, const Vector2f&);
+template Vector3f PathIntegrator::Li<SobolSampler>(Scene*, SobolSampler*, const Vector2f&);
+template Vector3f PathIntegrator::Li<ZSobolSampler>(Scene*, ZSobolSampler*, const Vector2f&);
+template Vector3f PathIntegrator::Li<PhiloxSampler>(Scene*, PhiloxSampler*, const Vector2f&);
+
+}
@@ -7,7 +7,7 @@
 
 namespace pt {
 
-AreaLight::AreaLight(Triangle* shape, const Vector3f& lemit) : m_shape(shape), m_lemit(lemit) {
+AreaLight::AreaLight(Triangle* shape, const Vector3f& lemit, uint32_t id) : m_shape(shape), m_lemit(lemit), m_id(id) {
 	m_area = shape->surfaceArea();
 }
 
@@ -0,0 +1,157 @@
+#include <pt/lightcache.h>
+
+namespace pt {
+
+inline uint64_t mixBits(uint64_t v) {
+	v ^= (v >> 31);
+	v *= 0x7fb5d329728ea185ULL;
+	v ^= (v >> 27);
+	v *= 0x81dadef4bc2dd44dULL;
+	v ^= (v >> 33);
+	return v;
+}
+
+LightCacheSelector::LightCacheSelector(std::vector<AreaLight*>* lights, const AABB& bounds, int resolution, float uniformProb)
+	: LightSelector(lights), m_cells(TableSize), m_uniformProb(std::clamp(uniformProb, 0.0f, 1.0f)) {
+	Vector3f extent = bounds.getMax() - bounds.getMin();
+	float cellSize = std::max(extent.maxCoeff() / resolution, Epsilon);
+	m_invCellSize = 1.0f / cellSize;
+	m_origin = bounds.getMin();
+}
+
+uint64_t LightCacheSelector::computeKey(const Vector3f& p, const Vector3f& n) const {
+	Vector3f g = (p - m_origin) * m_invCellSize;
+	uint64_t x = uint64_t(std::max(int64_t(g.x()), int64_t(0))) & 0xfffff;
+	uint64_t y = uint64_t(std::max(int64_t(g.y()), int64_t(0))) & 0xfffff;
+	uint64_t z = uint64_t(std::max(int64_t(g.z()), int64_t(0))) & 0xfffff;
+
+	// dominant axis and sign of the normal, lights behind a wall differ on both sides
+	int axis = 0;
+	n.cwiseAbs().maxCoeff(&axis);
+	uint64_t dir = 2 * axis + (n[axis] < 0.0f ? 1 : 0);
+
+	return ((x << 43) | (y << 23) | (z << 3) | dir) + 1;
+}
+
+LightCacheSelector::Cell* LightCacheSelector::findCell(uint64_t key, bool insert) {
+	size_t idx = mixBits(key) & (TableSize - 1);
+	for (int i = 0; i < MaxProbes; i++, idx = (idx + 1) & (TableSize - 1)) {
+		Cell& cell = m_cells[idx];
+		tbb::spin_mutex::scoped_lock lock(cell.mutex);
+		if (cell.key == key)
+			return &cell;
+		if (cell.key == 0) {
+			if (!insert) return nullptr;
+			cell.key = key;
+			return &cell;
+		}
+	}
+	return nullptr;
+}
+
+const LightCacheSelector::Cell* LightCacheSelector::findCell(uint64_t key) const {
+	// read-only after build(), no locking required
+	size_t idx = mixBits(key) & (TableSize - 1);
+	for (int i = 0; i < MaxProbes; i++, idx = (idx + 1) & (TableSize - 1)) {
+		const Cell& cell = m_cells[idx];
+		if (cell.key == key) return &cell;
+		if (cell.key == 0) return nullptr;
+	}
+	return nullptr;
+}
+
+void LightCacheSelector::record(const AreaLight* light, const Vector3f& p, const Vector3f& n, float contribution) {
+	if (!m_learning || !(contribution > 0.0f) || !std::isfinite(contribution))
+		return;
+
+	Cell* cell = findCell(computeKey(p, n), true);
+	if (!cell) return;
+
+	tbb::spin_mutex::scoped_lock lock(cell->mutex);
+	uint32_t id = light->getId();
+	for (int i = 0; i < cell->count; i++) {
+		if (cell->lights[i] == id) {
+			cell->weights[i] += contribution;
+			return;
+		}
+	}
+	if (cell->count < NumSlots) {
+		cell->lights[cell->count] = id;
+		cell->weights[cell->count] = contribution;
+		cell->count++;
+		return;
+	}
+
+	// replace the weakest light if the new one is stronger
+	int minSlot = int(std::min_element(cell->weights.begin(), cell->weights.end()) - cell->weights.begin());
+	if (contribution > cell->weights[minSlot]) {
+		cell->lights[minSlot] = id;
+		cell->weights[minSlot] = contribution;
+	}
+}
+
+void LightCacheSelector::build() {
+	for (Cell& cell : m_cells) {
+		cell.weightSum = 0.0f;
+		for (int i = 0; i < cell.count; i++)
+			cell.weightSum += cell.weights[i];
+	}
+	m_learning = false;
+}
+
+AreaLight* LightCacheSelector::select(float u) const {
+	return m_lights->at(std::min(static_cast<size_t>(u * m_lights->size()), m_lights->size() - 1));
+}
+
+AreaLight* LightCacheSelector::select(float u, const Vector3f& p, const Vector3f& n) const {
+	if (m_learning) return select(u);
+
+	const Cell* cell = findCell(computeKey(p, n));
+	if (!cell || cell->weightSum == 0.0f || u < m_uniformProb)
+		return select(cell && cell->weightSum > 0.0f ? u / m_uniformProb : u);
+
+	// sample the learned distribution
+	float target = (u - m_uniformProb) / (1.0f - m_uniformProb) * cell->weightSum;
+	for (int i = 0; i < cell->count - 1; i++) {
+		if (target < cell->weights[i])
+			return m_lights->at(cell->lights[i]);
+		target -= cell->weights[i];
+	}
+	return m_lights->at(cell->lights[cell->count - 1]);
+}
+
+float LightCacheSelector::pdf(const AreaLight* light, const Vector3f& p, const Vector3f& n) const {
+	float uniformPdf = 1.0f / m_lights->size();
+	if (m_learning) return uniformPdf;
+
+	const Cell* cell = findCell(computeKey(p, n));
+	if (!cell || cell->weightSum == 0.0f)
+		return uniformPdf;
+
+	float learnedPdf = 0.0f;
+	for (int i = 0; i < cell->count; i++) {
+		if (cell->lights[i] == light->getId()) {
+			learnedPdf = cell->weights[i] / cell->weightSum;
+			break;
+		}
+	}
+	return m_uniformProb * uniformPdf + (1.0f - m_uniformProb) * learnedPdf;
+}
+
+std::string LightCacheSelector::toString() const {
+	size_t used = std::count_if(m_cells.begin(), m_cells.end(), [](const Cell& c) { return c.key != 0; });
+	return tfm::format(
+		"LightCacheSelector[\n"
+		"  cells = %i / %i,\n"
+		"  cellSize = %f,\n"
+		"  uniformProb = %f,\n"
+		"  learning = %s\n"
+		"]",
+		used, TableSize,
+		1.0f / m_invCellSize,
+		m_uniformProb,
+		m_learning ? "true" : "false"
+	);
+}
+
+}
@@ -7,96 +7,21 @@
 #include <pt/integrator.h>
 #include <pt/scene.h>
 #include <pt/bitmap.h>
+#include <pt/filter.h>
 #include <pt/material.h>
+#include <pt/lightcache.h>
 #include <pt/bdpt.h>
 #include <pt/bdpt2.h>
+#include <pt/heatmap.h>
+#include <pt/stats.h>
+#include <pt/trace.h>
+#include <pt/render.h>
 
-#include <tbb/parallel_for.h>
-#include <tbb/blocked_range.h>
-#include <tbb/blocked_range2d.h>
 #include <tbb/task_scheduler_init.h>
 #include <thread>
 
 using namespace pt;
 
-std::unique_ptr<Bitmap> writeBitmap(ImageBlock* sampleBlock, ImageBlock* splatBlock = nullptr, float splatScale = 1.0) {
-    std::cout << "Writing result to bitmap .. ";
-    std::cout.flush();
-    Timer timer;
-
-    sampleBlock->lock();
-    if (splatBlock) splatBlock->lock();
-
-    const Vector2i& size = sampleBlock->getSize();
-    int bSize = sampleBlock->getBorderSize();
-    auto bitmap = std::make_unique<Bitmap>(size);
-
-    tbb::blocked_range2d<int> range(0, size.y(), 0, size.x()); // rows, cols
-
-    auto map = [&](const tbb::blocked_range2d<int>& r) {
-        for (int y = r.rows().begin(); y != r.rows().end(); ++y)
-            for (int x = r.cols().begin(); x != r.cols().end(); ++x) {
-                auto tmp = sampleBlock->coeff(y + bSize, x + bSize).divideByFilterWeight();
-                if (splatBlock) 
-                    tmp += splatBlock->coeff(y + bSize, x + bSize).head<3>() * splatScale;
-                bitmap->coeffRef(y, x) = tmp;
-            }
-    };
-
-    tbb::parallel_for(range, map);
-    std::cout << "done. (took " << timer.elapsedString() << ")" << endl;
-
-    sampleBlock->unlock();
-    if (splatBlock) splatBlock->unlock();
-    return bitmap;
-}
-
-void renderBlock(Scene* scene, Sampler* sampler, Integrator* integrator, ImageBlock& block) {
-    Vector2i offset = block.getOffset();
-    Vector2i size = block.getSize();
-
-    block.clear();
-    sampler->startBlockSample(offset);
-
-    for (uint32_t y = 0; y < size.y(); ++y) {
-        for (uint32_t x = 0; x < size.x(); ++x) {
-            for (uint32_t s = 0; s < sampler->getSPP(); s++) {
-                Vector2i pixel = Vector2i(x, y) + offset;
-                sampler->startPixelSample(pixel, s);
-                Vector2f pixelSample = pixel.cast<float>() + sampler->samplePixel2D();
-
-                Vector3f value = integrator->Li(scene, sampler, pixelSample);
-
-                block.addSample(pixelSample, value);
-            }
-        }
-    }
-}
-
-void render(Scene* scene, Sampler* sampler, Integrator* integrator, ImageBlock* result) {
-    Vector2i screenSize = scene->getCamera()->getScreenSize();
-
-    BlockGenerator blockGenerator(screenSize, PT_BLOCK_SIZE);
-    tbb::blocked_range<int> range(0, blockGenerator.getBlockCount());
-
-    auto map = [&](const tbb::blocked_range<int>& range) {
-        ImageBlock block(Vector2i(PT_BLOCK_SIZE), scene->getFilter());
-
-        // Create a clone of the sampler for the current thread
-        std::unique_ptr<Sampler> sampler_t(sampler->clone());
-
-        for (int i = range.begin(); i < range.end(); ++i) {
-            blockGenerator.next(block);
-
-            renderBlock(scene, sampler_t.get(), integrator, block);
-
-            result->put(block);
-        }
-    };
-
-    tbb::parallel_for(range, map);
-}
-
 int main(int argc, char **argv) {
 
     // default settings
@@ -105,6 +30,13 @@ int main(int argc, char **argv) {
     uint32_t spp = 256;
     bool useGui = true;
     bool useBDPT = false;
+    int risCandidates = 1;
+    bool useLightCache = false;
+    bool useFilterSampling = false;
+    std::string samplerName = "sobol"; // independent, philox, sobol, zsobol
+    RenderOptions renderOptions;
+    std::string heatmapMode; // empty, block or pixel
+    std::string tracePath;
 
     // parsing arguments
     for (int i = 1; i < argc; ++i) {
@@ -135,6 +67,72 @@ int main(int argc, char **argv) {
             }
             continue;
         }
+        else if (token == "--ris") {
+            if (i + 1 >= argc) {
+                cerr << "\"--ris\" argument expects a positive integer following it." << endl;
+                return -1;
+            }
+            risCandidates = atoi(argv[i + 1]);
+            i++;
+            if (risCandidates <= 0) {
+                cerr << "\"--ris\" argument expects a positive integer following it." << endl;
+                return -1;
+            }
+            continue;
+        }
+        else if (token == "--sampler") {
+            if (i + 1 >= argc) {
+                cerr << "\"--sampler\" argument expects independent, philox, sobol or zsobol following it." << endl;
+                return -1;
+            }
+            samplerName = argv[i + 1];
+            i++;
+            if (samplerName != "independent" && samplerName != "philox" && samplerName != "sobol" && samplerName != "zsobol") {
+                cerr << "\"--sampler\" argument expects independent, philox, sobol or zsobol following it." << endl;
+                return -1;
+            }
+            continue;
+        }
+        else if (token == "--tile-order") {
+            std::string name = i + 1 < argc ? argv[i + 1] : "";
+            if (name != "spiral" && name != "hilbert") {
+                cerr << "\"--tile-order\" argument expects spiral or hilbert following it." << endl;
+                return -1;
+            }
+            renderOptions.tileOrder = name == "hilbert" ? BlockGenerator::Order::Hilbert : BlockGenerator::Order::Spiral;
+            i++;
+            continue;
+        }
+        else if (token == "--balance") {
+            renderOptions.balanceTiles = true;
+            continue;
+        }
+        else if (token == "--trace") {
+            if (i + 1 >= argc) {
+                cerr << "\"--trace\" argument expects a file name following it." << endl;
+                return -1;
+            }
+            tracePath = argv[i + 1];
+            i++;
+            continue;
+        }
+        else if (token == "--heatmap") {
+            heatmapMode = i + 1 < argc ? argv[i + 1] : "";
+            if (heatmapMode != "block" && heatmapMode != "pixel") {
+                cerr << "\"--heatmap\" argument expects block or pixel following it." << endl;
+                return -1;
+            }
+            i++;
+            continue;
+        }
+        else if (token == "--light-cache") {
+            useLightCache = true;
+            continue;
+        }
+        else if (token == "--fis") {
+            useFilterSampling = true;
+            continue;
+        }
         else if (token == "--no-gui") {
             useGui = false;
             continue;
@@ -152,12 +150,19 @@ int main(int argc, char **argv) {
 			return -1;
 		}
     }
+    if (useFilterSampling && useBDPT) {
+        // the splats of BDPT would be box filtered while the camera samples are not
+        cerr << "\"--fis\" cannot be combined with \"--bdpt\"." << endl;
+        return -1;
+    }
 
     // apply settings
     tbb::task_scheduler_init init(threadCount);
     std::string obj_path = tfm::format("./scenes/%s/%s.obj", sceneName, sceneName);
     std::string xml_path = tfm::format("./scenes/%s/%s.xml", sceneName, sceneName);
     std::string folder_path = getFolderPath(obj_path);
+    if (!tracePath.empty())
+        trace::start(tracePath);
 
     try {
         // create scene
@@ -165,12 +170,15 @@ int main(int argc, char **argv) {
         scene.loadOBJ(obj_path);
         scene.loadXML(xml_path);
         scene.preprocess();
+        if (useFilterSampling)
+            scene.enableFilterSampling();
         std::cout << scene.toString() << std::endl;
 
-        // result block
+        // result block (no filter and no border with filter importance sampling)
         Vector2i screenSize = scene.getCamera()->getScreenSize();
-        ImageBlock sampleResult(screenSize, scene.getFilter());
-        ImageBlock splatResult(screenSize, scene.getFilter());
+        const Filter* filmFilter = useFilterSampling ? nullptr : scene.getFilter();
+        ImageBlock sampleResult(screenSize, filmFilter);
+        ImageBlock splatResult(screenSize, filmFilter);
         float splatScale = 1.0f / spp;
 
         // gui
@@ -187,6 +195,7 @@ int main(int argc, char **argv) {
                 std::cout << "Rendering albedo map .. ";
                 std::cout.flush();
                 Timer timer;
+                PT_TRACE_SCOPE("Albedo pass", "render");
 
                 BaseColorIntegrator integrator;
                 SobolSampler sampler(32, screenSize);
@@ -206,6 +215,7 @@ int main(int argc, char **argv) {
                 std::cout << "Rendering normal map .. ";
                 std::cout.flush();
                 Timer timer;
+                PT_TRACE_SCOPE("Normal pass", "render");
 
                 GeometryIntegrator integrator;
                 SobolSampler sampler(32, screenSize);
@@ -220,11 +230,30 @@ int main(int argc, char **argv) {
                 result.get()->saveEXR(folder_path + "normal.exr");
             }
 
+            // learning light importance cache with a low spp probe
+            if (useLightCache && !useBDPT) {
+                std::cout << "Learning light cache .. ";
+                std::cout.flush();
+                Timer timer;
+                PT_TRACE_SCOPE("Light cache pass", "render");
+
+                LightCacheSelector* lightCache = scene.enableLightCache();
+                PathIntegrator integrator(risCandidates);
+                SobolSampler sampler(4, screenSize);
+
+                sampleResult.clear();
+                splatResult.clear();
+                render(&scene, &sampler, &integrator, &sampleResult);
+                lightCache->build();
+                std::cout << "done. (took " << timer.elapsedString() << ")" << endl;
+            }
+
             // rendering
             {
                 std::cout << "Rendering .. ";
                 std::cout.flush();
                 Timer timer;
+                PT_TRACE_SCOPE("Final pass", "render");
 
                 Integrator* integrator;
                 if (useBDPT) { 
@@ -232,19 +261,40 @@ int main(int argc, char **argv) {
                     integrator->setSplatBlock(&splatResult);
                 }
                 else {
-                    integrator = new PathIntegrator();
+                    integrator = new PathIntegrator(risCandidates);
+                }
+                std::unique_ptr<Sampler> sampler;
+                if (samplerName == "independent")
+                    sampler.reset(new IndependentSampler(spp));
+                else if (samplerName == "philox")
+                    sampler.reset(new PhiloxSampler(spp));
+                else if (samplerName == "zsobol")
+                    sampler.reset(new ZSobolSampler(spp, screenSize));
+                else
+                    sampler.reset(new SobolSampler(spp, screenSize));
+
+                std::unique_ptr<CostHeatmap> heatmap;
+                if (!heatmapMode.empty()) {
+                    heatmap.reset(new CostHeatmap(screenSize, heatmapMode == "pixel"));
+                    renderOptions.heatmap = heatmap.get();
                 }
-                SobolSampler sampler(spp, screenSize);
-                //IndependentSampler sampler(spp);
 
                 sampleResult.clear();
                 splatResult.clear();
-                render(&scene, &sampler, integrator, &sampleResult);
+                // only report the final render (without the balancing probe)
+                stats::clear();
+                renderOptions.afterProbe = [] { stats::clear(); };
+                render(&scene, sampler.get(), integrator, &sampleResult, renderOptions);
                 delete integrator;
+                stats::print(std::cout);
 
                 auto result = writeBitmap(&sampleResult, &splatResult, splatScale);
                 result.get()->savePNG(folder_path + "result.png");
                 result.get()->saveEXR(folder_path + "result.exr");
+                if (heatmap) {
+                    std::cout << heatmap->toString() << std::endl;
+                    heatmap->save(folder_path + "heatmap");
+                }
                 std::cout << "done. (took " << timer.elapsedString() << ")" << endl;
             }
         });
@@ -252,6 +302,7 @@ int main(int argc, char **argv) {
         if (useGui) nanogui::mainloop(50.f);
 
         render_thread.join();
+        trace::stop();
 
         if (useGui) {
             delete gui;
@@ -1,8 +1,10 @@
 ﻿#include <pt/material.h>
 #include <pt/color.h>
-#include <pt/bitmap.h>
+#include <pt/texture.h>
 #include <pt/shape.h>
 #include <pt/tangent.h>
+#include <pt/simd.h>
+#include <pt/stats.h>
 
 namespace pt {
 
@@ -15,103 +17,191 @@ Vector3f Material::getBaseColor(const Vector2f& uv) const {
 		return getBaseColor();
 }
 
-Vector3f Material::BRDF(const Vector3f& wo, const Vector3f& wi, const Intersection& its) const {
-	// not on the same hemisphere
-	//float cosTheta = wi.dot(its.n);
-	//if (cosTheta < 0.0f) return Vector3f(0.0f);
+Vector3f Material::getBaseColor(const Intersection& its) const {
+	if (m_diffuse_texture) {
+		Color3f c = m_diffuse_texture->sample(its.uv, its.getUVFootprint());
+		return Vector3f(c.x(), c.y(), c.z());
+	}
+	else
+		return getBaseColor();
+}
 
+BSDF::BSDF(const Material* material, const Intersection& its, const Vector3f& wo)
+	: m_n(its.n), m_r(reflect(wo, its.n)), m_ts(its.ts) {
 	// hard code
-	if (m_specular.x() > 999 || m_specular.y() > 999 || m_specular.z() > 999)
-		return Vector3f(0.0);
+	if (material->isMirror()) {
+		m_mirror = true;
+		return;
+	}
+
+	setLobes(material->getBaseColor(its), material->getSpecular(), material->getShininess());
+}
 
-	// compute lambert diffuse
-	Vector3f diffuse = getBaseColor(its.uv) * INV_PI;
+void BSDF::setLobes(const Vector3f& diffuse, const Vector3f& specular, float shininess) {
+	float sumKd = diffuse.sum();
+	float sumKs = specular.sum();
+	float sumKdKs = sumKd + sumKs;
+	if (sumKdKs == 0.0f) return; // black body
+
+	m_black = false;
+	m_phong = sumKs > 0.0f;
+	m_shininess = shininess;
+	m_diffuse = diffuse * INV_PI;
+	m_specular = specular * (m_shininess + 2.0f) * INV_TWOPI;
+	m_specPdfScale = (m_shininess + 1.0f) * INV_TWOPI;
+	m_specProb = sumKs / sumKdKs;
+}
 
-	// compute phong specular
-	Vector3f r = reflect(wo, its.n);
-	float cosRV = std::max(wi.dot(r), 0.0f);
-	float normalization = (m_shininess + 2.0f) * INV_TWOPI;
-	Vector3f specular = m_specular * normalization * std::powf(cosRV, m_shininess);
+BRDFEval BSDF::eval(const Vector3f& wi) const {
+	if (m_black) return BRDFEval();
 
-	// return combined result
-	return diffuse + specular;
+	BRDFEval result;
+	float pdf_diff = absDot(wi, m_n) * INV_PI; // may be incorrect
+	if (!m_phong) { // lambert only
+		result.f = m_diffuse;
+		result.pdf = pdf_diff;
+		return result;
+	}
+
+	// phong lobe, shared by the BRDF value and its pdf
+	float cosRV = std::max(wi.dot(m_r), 0.0f);
+	float powRV = std::powf(cosRV, m_shininess);
+	result.f = m_diffuse + m_specular * powRV;
+
+	float pdf_spec = m_specPdfScale * powRV;
+	result.pdf = mix(pdf_diff, pdf_spec, m_specProb);
+	return result;
 }
 
-BRDFSample Material::sampleBRDF(const Vector3f& wo, float uc, const Vector2f& u, const Intersection& its) const {
+PT_STAT_COUNTER(statMirrorSamples, "Material", "Mirror samples");
+PT_STAT_COUNTER(statSpecularSamples, "Material", "Phong specular lobe samples");
+PT_STAT_COUNTER(statDiffuseSamples, "Material", "Diffuse lobe samples");
+PT_STAT_RATIO(statBelowSurface, "Material", "Samples below the surface");
+
+// Material::sampleBRDF() and the integrators all sample through here
+BRDFSample BSDF::sample(float uc, const Vector2f& u) const {
 	/**
 	* Lafortune, Eric P. and Yves D. Willems. “Using the modified Phong reflectance model for physically based rendering.” (1994).
 	*/
 
-	// hard code
-	if (m_specular.x() > 999 || m_specular.y() > 999 || m_specular.z() > 999)
-		return BRDFSample(
-			reflect(wo, its.n), 0.0,
-			Vector3f(1.0), true
-		);
-
-	Vector3f diffuse = getBaseColor(its.uv); // sample diffuse color
+	if (m_mirror) {
+		PT_STAT_ADD(statMirrorSamples, 1);
+		return BRDFSample(m_r, 0.0, Vector3f(1.0), true);
+	}
 
-	float sumKd = diffuse.sum();
-	float sumKs = m_specular.sum();
-	float sumKdKs = sumKd + sumKs;
-	if (sumKdKs == 0.0f) return BRDFSample(); // black body
-	float specProb = sumKs / sumKdKs;
+	if (m_black) return BRDFSample();
 
 	Vector3f wi;
-	Vector3f r = reflect(wo, its.n);
-	if (uc < specProb) { // sample specular
-		TangentSpace ts(r);
+	if (uc < m_specProb) { // sample specular
+		PT_STAT_ADD(statSpecularSamples, 1);
+		TangentSpace ts(m_r);
 		Vector3f w = samplePhongSpecularLobe(u, m_shininess);
 		wi = ts.toWorld(w);
 	}
 	else { // sample diffuse
+		PT_STAT_ADD(statDiffuseSamples, 1);
 		Vector3f w = sampleCosineHemisphere(u);
-		wi = its.ts.toWorld(w);
+		wi = m_ts.toWorld(w);
 	}
 	wi.normalize();
 
 	// not on the same hemisphere
-	float cosTheta = wi.dot(its.n);
+	float cosTheta = wi.dot(m_n);
+	PT_STAT_RATIO_ADD(statBelowSurface, cosTheta < 0.0f ? 1 : 0, 1);
 	if (cosTheta < 0.0f) return BRDFSample();
 
-	// specular pdf
-	float cosRV = std::max(wi.dot(r), 0.0f);
-	float powRV = std::powf(cosRV, m_shininess);
-	float pdf_spec = (m_shininess + 1.0f) * INV_TWOPI * powRV;
-
-	// diffuse pdf
-	float pdf_diff = cosTheta * INV_PI;
-
-	// BRDF value
-	Vector3f f = diffuse * INV_PI + m_specular * (m_shininess + 2.0f) * INV_TWOPI * powRV;
-
-	float pdf = mix(pdf_diff, pdf_spec, specProb);
-	return BRDFSample(wi, pdf, f);
+	BRDFEval e = eval(wi);
+	return BRDFSample(wi, e.pdf, e.f);
 }
 
-float Material::pdf(const Vector3f& wo, const Vector3f& wi, const Intersection& its) const {
-	// hard code
-	if (m_specular.x() > 999 || m_specular.y() > 999 || m_specular.z() > 999)
-		return 0.0;
+void BSDF::eval(const Vector3f* wi, BRDFEval* results, int count) const {
+	BSDFQuery queries[simd::Width];
+	for (int start = 0; start < count; start += simd::Width) {
+		int n = std::min(count - start, simd::Width);
+		for (int i = 0; i < n; i++)
+			queries[i] = BSDFQuery { this, wi[start + i] };
+		evalBatch(queries, results + start, n);
+	}
+}
 
-	Vector3f diffuse = getBaseColor(its.uv);
+void BSDF::evalBatch(const BSDFQuery* queries, BRDFEval* results, int count) {
+#if defined(__AVX2__)
+	for (int start = 0; start < count; start += simd::Width) {
+		int n = std::min(count - start, simd::Width);
+
+		// gather lane parameters (SoA), unused and black lanes evaluate to zero
+		alignas(32) float dr[8] = { 0 }, dg[8] = { 0 }, db[8] = { 0 };
+		alignas(32) float sr[8] = { 0 }, sg[8] = { 0 }, sb[8] = { 0 };
+		alignas(32) float shininess[8] = { 0 }, pdfScale[8] = { 0 }, specProb[8] = { 0 }, valid[8] = { 0 };
+		alignas(32) float nx[8] = { 0 }, ny[8] = { 0 }, nz[8] = { 0 };
+		alignas(32) float rx[8] = { 0 }, ry[8] = { 0 }, rz[8] = { 0 };
+		alignas(32) float wx[8] = { 0 }, wy[8] = { 0 }, wz[8] = { 0 };
+		for (int i = 0; i < n; i++) {
+			const BSDF& b = *queries[start + i].bsdf;
+			const Vector3f& wi = queries[start + i].wi;
+			if (b.m_black) continue;
+			valid[i] = 1.0f;
+			dr[i] = b.m_diffuse.x(); dg[i] = b.m_diffuse.y(); db[i] = b.m_diffuse.z();
+			nx[i] = b.m_n.x(); ny[i] = b.m_n.y(); nz[i] = b.m_n.z();
+			wx[i] = wi.x(); wy[i] = wi.y(); wz[i] = wi.z();
+			if (!b.m_phong) continue;
+			sr[i] = b.m_specular.x(); sg[i] = b.m_specular.y(); sb[i] = b.m_specular.z();
+			rx[i] = b.m_r.x(); ry[i] = b.m_r.y(); rz[i] = b.m_r.z();
+			shininess[i] = b.m_shininess;
+			pdfScale[i] = b.m_specPdfScale;
+			specProb[i] = b.m_specProb;
+		}
+
+		__m256 vwx = _mm256_load_ps(wx), vwy = _mm256_load_ps(wy), vwz = _mm256_load_ps(wz);
+
+		// phong lobe
+		__m256 cosRV = _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(vwx, _mm256_load_ps(rx)), _mm256_mul_ps(vwy, _mm256_load_ps(ry))),
+			_mm256_mul_ps(vwz, _mm256_load_ps(rz)));
+		cosRV = _mm256_max_ps(cosRV, _mm256_setzero_ps());
+		__m256 powRV = simd::pow(cosRV, _mm256_load_ps(shininess));
+
+		alignas(32) float fr[8], fg[8], fb[8], pdf[8];
+		_mm256_store_ps(fr, _mm256_add_ps(_mm256_load_ps(dr), _mm256_mul_ps(_mm256_load_ps(sr), powRV)));
+		_mm256_store_ps(fg, _mm256_add_ps(_mm256_load_ps(dg), _mm256_mul_ps(_mm256_load_ps(sg), powRV)));
+		_mm256_store_ps(fb, _mm256_add_ps(_mm256_load_ps(db), _mm256_mul_ps(_mm256_load_ps(sb), powRV)));
+
+		// pdf = mix(pdf_diff, pdf_spec, specProb)
+		__m256 cosTheta = simd::abs(_mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(vwx, _mm256_load_ps(nx)), _mm256_mul_ps(vwy, _mm256_load_ps(ny))),
+			_mm256_mul_ps(vwz, _mm256_load_ps(nz))));
+		__m256 pdfDiff = _mm256_mul_ps(cosTheta, _mm256_set1_ps(INV_PI));
+		__m256 pdfSpec = _mm256_mul_ps(_mm256_load_ps(pdfScale), powRV);
+		__m256 vpdf = _mm256_add_ps(pdfDiff, _mm256_mul_ps(_mm256_sub_ps(pdfSpec, pdfDiff), _mm256_load_ps(specProb)));
+		_mm256_store_ps(pdf, _mm256_mul_ps(vpdf, _mm256_load_ps(valid)));
+
+		for (int i = 0; i < n; i++) {
+			results[start + i].f = Vector3f(fr[i], fg[i], fb[i]);
+			results[start + i].pdf = pdf[i];
+		}
+	}
+#else
+	for (int i = 0; i < count; i++)
+		results[i] = queries[i].bsdf->eval(queries[i].wi);
+#endif
+}
 
-	float sumKd = diffuse.sum();
-	float sumKs = m_specular.sum();
-	float sumKdKs = sumKd + sumKs;
-	if (sumKdKs == 0.0f) return 0.0f; // black body
-	float specProb = sumKs / sumKdKs;
-	Vector3f r = reflect(wo, its.n);
+BSDF BSDF::withOutgoing(const Vector3f& wo) const {
+	BSDF result = *this;
+	result.m_r = reflect(wo, m_n);
+	return result;
+}
 
-	// specular pdf
-	float cosRV = std::max(wi.dot(r), 0.0f);
-	float pdf_spec = (m_shininess + 1.0f) * INV_TWOPI * std::powf(cosRV, m_shininess);
+Vector3f Material::BRDF(const Vector3f& wo, const Vector3f& wi, const Intersection& its) const {
+	return getBSDF(its, wo).eval(wi).f;
+}
 
-	// diffuse pdf
-	float cosTheta = absDot(wi, its.n); // may be incorrect
-	float pdf_diff = cosTheta * INV_PI;
+BRDFSample Material::sampleBRDF(const Vector3f& wo, float uc, const Vector2f& u, const Intersection& its) const {
+	return getBSDF(its, wo).sample(uc, u);
+}
 
-	return mix(pdf_diff, pdf_spec, specProb);
+float Material::pdf(const Vector3f& wo, const Vector3f& wi, const Intersection& its) const {
+	return getBSDF(its, wo).eval(wi).pdf;
 }
 
 std::string Material::toString() const {
@@ -0,0 +1,92 @@
+#include <pt/materialtable.h>
+#include <pt/texture.h>
+#include <pt/shape.h>
+
+namespace pt {
+
+void MaterialTable::build(const std::vector<Material*>& materials) {
+	size_t n = materials.size();
+	m_kinds.resize(n);
+	m_diffuse.resize(n);
+	m_specular.resize(n);
+	m_shininess.resize(n);
+	m_textures.resize(n);
+
+	for (size_t i = 0; i < n; i++) {
+		const Material* material = materials[i];
+		Vector3f kd = material->getBaseColor();
+		const Vector3f& ks = material->getSpecular();
+		float shininess = material->getShininess();
+		const Texture* texture = material->getTexture();
+		bool phong = ks.sum() > 0.0f;
+
+		MaterialKind kind;
+		if (material->isMirror()) kind = MaterialKind::Mirror;
+		else if (texture) kind = phong ? MaterialKind::TexturedLambertPhong : MaterialKind::TexturedLambert;
+		else if (kd.sum() + ks.sum() == 0.0f) kind = MaterialKind::Black;
+		else kind = phong ? MaterialKind::LambertPhong : MaterialKind::Lambert;
+
+		m_kinds[i] = kind;
+		m_diffuse[i] = kd;
+		m_specular[i] = ks;
+		m_shininess[i] = shininess;
+		m_textures[i] = texture;
+	}
+}
+
+template <MaterialKind K>
+BSDF MaterialTable::makeBSDF(uint32_t id, const Intersection& its, const Vector3f& wo) const {
+	constexpr bool textured = K == MaterialKind::TexturedLambert || K == MaterialKind::TexturedLambertPhong;
+
+	// same geometry as BSDF::BSDF(), the lobes come from the shared BSDF::setLobes()
+	BSDF bsdf;
+	bsdf.m_n = its.n;
+	bsdf.m_r = reflect(wo, its.n);
+	bsdf.m_ts = its.ts;
+	if constexpr (K == MaterialKind::Mirror) {
+		bsdf.m_mirror = true;
+		return bsdf;
+	}
+	if constexpr (K == MaterialKind::Black)
+		return bsdf;
+
+	if constexpr (textured) {
+		Color3f c = m_textures[id]->sample(its.uv, its.getUVFootprint());
+		bsdf.setLobes(Vector3f(c.x(), c.y(), c.z()), m_specular[id], m_shininess[id]);
+	}
+	else
+		bsdf.setLobes(m_diffuse[id], m_specular[id], m_shininess[id]);
+	return bsdf;
+}
+
+BSDF MaterialTable::getBSDF(const Intersection& its, const Vector3f& wo) const {
+	uint32_t id = its.getMaterialId();
+	switch (m_kinds[id]) {
+	case MaterialKind::Lambert: return makeBSDF<MaterialKind::Lambert>(id, its, wo);
+	case MaterialKind::LambertPhong: return makeBSDF<MaterialKind::LambertPhong>(id, its, wo);
+	case MaterialKind::Mirror: return makeBSDF<MaterialKind::Mirror>(id, its, wo);
+	case MaterialKind::TexturedLambert: return makeBSDF<MaterialKind::TexturedLambert>(id, its, wo);
+	case MaterialKind::TexturedLambertPhong: return makeBSDF<MaterialKind::TexturedLambertPhong>(id, its, wo);
+	default: return makeBSDF<MaterialKind::Black>(id, its, wo);
+	}
+}
+
+std::string MaterialTable::toString() const {
+	int counts[6] = { 0 };
+	for (MaterialKind kind : m_kinds)
+		counts[int(kind)]++;
+
+	return tfm::format(
+		"MaterialTable[\n"
+		"  black = %i,\n"
+		"  lambert = %i,\n"
+		"  lambert_phong = %i,\n"
+		"  mirror = %i,\n"
+		"  textured_lambert = %i,\n"
+		"  textured_lambert_phong = %i\n"
+		"]",
+		counts[0], counts[1], counts[2], counts[3], counts[4], counts[5]
+	);
+}
+
+}
@@ -0,0 +1,246 @@
+#include <pt/render.h>
+#include <pt/timer.h>
+#include <pt/camera.h>
+#include <pt/sampler.h>
+#include <pt/integrator.h>
+#include <pt/scene.h>
+#include <pt/bitmap.h>
+#include <pt/filter.h>
+#include <pt/bdpt2.h>
+#include <pt/heatmap.h>
+#include <pt/trace.h>
+
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <tbb/blocked_range2d.h>
+#include <tbb/task_arena.h>
+#include <chrono>
+
+namespace pt {
+
+std::unique_ptr<Bitmap> writeBitmap(ImageBlock* sampleBlock, ImageBlock* splatBlock, float splatScale) {
+    std::cout << "Writing result to bitmap .. ";
+    std::cout.flush();
+    Timer timer;
+    PT_TRACE_SCOPE("Write bitmap", "output");
+
+    sampleBlock->lock();
+    if (splatBlock) splatBlock->lock();
+
+    const Vector2i& size = sampleBlock->getSize();
+    int bSize = sampleBlock->getBorderSize();
+    auto bitmap = std::make_unique<Bitmap>(size);
+
+    tbb::blocked_range2d<int> range(0, size.y(), 0, size.x()); // rows, cols
+
+    auto map = [&](const tbb::blocked_range2d<int>& r) {
+        for (int y = r.rows().begin(); y != r.rows().end(); ++y)
+            for (int x = r.cols().begin(); x != r.cols().end(); ++x) {
+                auto tmp = sampleBlock->coeff(y + bSize, x + bSize).divideByFilterWeight();
+                if (splatBlock) 
+                    tmp += splatBlock->coeff(y + bSize, x + bSize).head<3>() * splatScale;
+                bitmap->coeffRef(y, x) = tmp;
+            }
+    };
+
+    tbb::parallel_for(range, map);
+    std::cout << "done. (took " << timer.elapsedString() << ")" << endl;
+
+    sampleBlock->unlock();
+    if (splatBlock) splatBlock->unlock();
+    return bitmap;
+}
+
+// arguments of the trace event of a block
+static std::string traceArgs(const ImageBlock& block) {
+    return tfm::format("\"x\": %i, \"y\": %i, \"width\": %i, \"height\": %i",
+        block.getOffset().x(), block.getOffset().y(), block.getSize().x(), block.getSize().y());
+}
+
+template <typename SamplerT, typename IntegratorT>
+void renderBlock(Scene* scene, SamplerT* sampler, IntegratorT* integrator, ImageBlock& block, CostHeatmap* heatmap = nullptr) {
+    Vector2i offset = block.getOffset();
+    Vector2i size = block.getSize();
+    const FilterSampler* filterSampler = scene->getFilterSampler();
+    bool timePixels = heatmap && heatmap->isPerPixel();
+    auto blockStart = std::chrono::steady_clock::now();
+
+    block.clear();
+    sampler->startBlockSample(offset);
+
+    // visit the pixels in Morton order (over the enclosing power of two square)
+    uint32_t extent = 1;
+    while (extent < uint32_t(size.x()) || extent < uint32_t(size.y())) extent <<= 1;
+
+    for (uint64_t code = 0; code < uint64_t(extent) * extent; ++code) {
+        uint32_t x, y;
+        decodeMorton2(code, x, y);
+        if (x >= uint32_t(size.x()) || y >= uint32_t(size.y()))
+            continue;
+
+        auto pixelStart = timePixels ? std::chrono::steady_clock::now() : blockStart;
+        for (uint32_t s = 0; s < sampler->getSPP(); s++) {
+            Vector2i pixel = Vector2i(x, y) + offset;
+            sampler->startPixelSample(pixel, s);
+
+            if (filterSampler) {
+                // offset from the pixel center drawn from the filter, the sample only goes to this pixel
+                Vector2f pixelSample = pixel.cast<float>() + Vector2f(0.5f) + filterSampler->sample(sampler->samplePixel2D());
+                Vector3f value = integrator->Li(scene, sampler, pixelSample);
+                block.putPixel(pixel, Color3f(value.x(), value.y(), value.z()));
+                continue;
+            }
+
+            Vector2f pixelSample = pixel.cast<float>() + sampler->samplePixel2D();
+
+            Vector3f value = integrator->Li(scene, sampler, pixelSample);
+
+            block.addSample(pixelSample, value);
+        }
+
+        if (timePixels) {
+            std::chrono::duration<float> time = std::chrono::steady_clock::now() - pixelStart;
+            heatmap->addPixel(Vector2i(x, y) + offset, time.count());
+        }
+    }
+
+    if (heatmap) {
+        std::chrono::duration<float> time = std::chrono::steady_clock::now() - blockStart;
+        heatmap->addBlock(offset, size, time.count());
+    }
+}
+
+// time every block at a low sample count to predict its cost in the final render
+template <typename IntegratorT>
+std::vector<float> measureBlockCost(Scene* scene, IntegratorT* integrator) {
+    constexpr uint32_t ProbeSPP = 1;
+    Vector2i screenSize = scene->getCamera()->getScreenSize();
+    BlockGenerator blockGenerator(screenSize, PT_BLOCK_SIZE);
+    int numBlocksX = blockGenerator.getBlockCounts().x();
+    std::vector<float> cost(blockGenerator.getBlockCount(), 0.0f);
+    IndependentSampler sampler(ProbeSPP);
+
+    // splats of the probe go to a scratch block instead of the frame
+    ImageBlock* splatTarget = integrator->getSplatBlock();
+    std::unique_ptr<ImageBlock> scratch;
+    if (splatTarget) {
+        scratch.reset(new ImageBlock(screenSize, scene->getFilterSampler() ? nullptr : scene->getFilter()));
+        integrator->setSplatBlock(scratch.get());
+    }
+
+    auto map = [&](const tbb::blocked_range<int>& range) {
+        ImageBlock block(Vector2i(PT_BLOCK_SIZE), scene->getFilterSampler() ? nullptr : scene->getFilter());
+        std::unique_ptr<Sampler> sampler_t(sampler.clone());
+        IndependentSampler* sampler_p = static_cast<IndependentSampler*>(sampler_t.get());
+
+        for (int i = range.begin(); i < range.end(); ++i) {
+            blockGenerator.next(block);
+            PT_TRACE_SCOPE("Probe block", "render", trace::isEnabled() ? traceArgs(block) : std::string());
+
+            auto start = std::chrono::steady_clock::now();
+            renderBlock(scene, sampler_p, integrator, block);
+            integrator->flushSplats();
+            std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+
+            Vector2i index = block.getOffset() / PT_BLOCK_SIZE;
+            cost[index.y() * numBlocksX + index.x()] = time.count();
+        }
+    };
+
+    tbb::parallel_for(tbb::blocked_range<int>(0, blockGenerator.getBlockCount()), map);
+
+    if (splatTarget)
+        integrator->setSplatBlock(splatTarget);
+    return cost;
+}
+
+template <typename SamplerT, typename IntegratorT>
+void renderSpecialized(Scene* scene, SamplerT* sampler, IntegratorT* integrator, ImageBlock* result, const RenderOptions& options) {
+    Vector2i screenSize = scene->getCamera()->getScreenSize();
+    // tiles have no border with filter importance sampling
+    const Filter* tileFilter = scene->getFilterSampler() ? nullptr : scene->getFilter();
+
+    if (options.balanceTiles) {
+        TileScheduler scheduler(screenSize, PT_BLOCK_SIZE, measureBlockCost(scene, integrator),
+            tbb::this_task_arena::max_concurrency());
+        if (options.afterProbe)
+            options.afterProbe();
+
+        auto map = [&](const tbb::blocked_range<int>& range) {
+            ImageBlock block(Vector2i(PT_BLOCK_SIZE), tileFilter);
+            std::unique_ptr<Sampler> sampler_t(sampler->clone());
+            SamplerT* sampler_p = static_cast<SamplerT*>(sampler_t.get());
+
+            for (int i = range.begin(); i < range.end(); ++i) {
+                const TileScheduler::WorkItem* item = scheduler.next();
+                for (const auto& b : item->blocks) {
+                    block.setOffset(b.first);
+                    block.setSize(b.second);
+                    PT_TRACE_SCOPE("Block", "render", trace::isEnabled() ? traceArgs(block) : std::string());
+
+                    renderBlock(scene, sampler_p, integrator, block, options.heatmap);
+                    integrator->flushSplats();
+
+                    result->put(block);
+                }
+            }
+        };
+
+        // one item per task, the items are already sorted longest first
+        tbb::parallel_for(tbb::blocked_range<int>(0, scheduler.getItemCount()), map, tbb::simple_partitioner());
+        return;
+    }
+
+    BlockGenerator blockGenerator(screenSize, PT_BLOCK_SIZE, options.tileOrder);
+    tbb::blocked_range<int> range(0, blockGenerator.getBlockCount());
+
+    auto map = [&](const tbb::blocked_range<int>& range) {
+        ImageBlock block(Vector2i(PT_BLOCK_SIZE), tileFilter);
+
+        // Create a clone of the sampler for the current thread
+        std::unique_ptr<Sampler> sampler_t(sampler->clone());
+        SamplerT* sampler_p = static_cast<SamplerT*>(sampler_t.get());
+
+        for (int i = range.begin(); i < range.end(); ++i) {
+            blockGenerator.next(block);
+            PT_TRACE_SCOPE("Block", "render", trace::isEnabled() ? traceArgs(block) : std::string());
+
+            renderBlock(scene, sampler_p, integrator, block, options.heatmap);
+            integrator->flushSplats();
+
+            result->put(block);
+        }
+    };
+
+    tbb::parallel_for(range, map);
+}
+
+template <typename SamplerT>
+void renderWithSampler(Scene* scene, SamplerT* sampler, Integrator* integrator, ImageBlock* result, const RenderOptions& options) {
+    if (auto path = dynamic_cast<PathIntegrator*>(integrator))
+        renderSpecialized(scene, sampler, path, result, options);
+    else if (auto baseColor = dynamic_cast<BaseColorIntegrator*>(integrator))
+        renderSpecialized(scene, sampler, baseColor, result, options);
+    else if (auto geometry = dynamic_cast<GeometryIntegrator*>(integrator))
+        renderSpecialized(scene, sampler, geometry, result, options);
+    else if (auto bdpt = dynamic_cast<BDPTIntegrator2*>(integrator))
+        renderSpecialized(scene, sampler, bdpt, result, options);
+    else
+        renderSpecialized(scene, sampler, integrator, result, options);
+}
+
+// pick the render loop specialized for the concrete sampler and integrator once per frame
+void render(Scene* scene, Sampler* sampler, Integrator* integrator, ImageBlock* result, const RenderOptions& options) {
+    if (auto sobol = dynamic_cast<SobolSampler*>(sampler))
+        renderWithSampler(scene, sobol, integrator, result, options);
+    else if (auto zsobol = dynamic_cast<ZSobolSampler*>(sampler))
+        renderWithSampler(scene, zsobol, integrator, result, options);
+    else if (auto philox = dynamic_cast<PhiloxSampler*>(sampler))
+        renderWithSampler(scene, philox, integrator, result, options);
+    else if (auto independent = dynamic_cast<IndependentSampler*>(sampler))
+        renderWithSampler(scene, independent, integrator, result, options);
+    else
+        renderSpecialized(scene, sampler, integrator, result, options);
+}
+
+}
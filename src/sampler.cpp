@@ -1,19 +1,10 @@
 #include <pt/sampler.h>
+#include <pt/vec.h>
 
 
 namespace sobol {
 
-inline float sobolSample(int64_t a, int dimension) {
-    uint32_t v = 0;
-    // Compute initial Sobol\+$'$ sample _v_ using generator matrices
-    for (int i = dimension * SobolMatrixSize; a != 0; a >>= 1, i++)
-        if (a & 1)
-            v ^= SobolMatrices32[i];
-    // No randomize
-    return std::min(v * 0x1p-32f, FloatOneMinusEpsilon);
-}
-
-inline uint64_t sobolIntervalToIndex(uint32_t m, uint64_t frame, pt::Vector2i p) {
+uint64_t sobolIntervalToIndex(uint32_t m, uint64_t frame, pt::Vector2i p) {
     if (m == 0)
         return frame;
 
@@ -86,50 +77,169 @@ inline constexpr int64_t roundUpPow2(int64_t v) {
     return v + 1;
 }
 
-SobolSampler::SobolSampler(uint32_t spp, Vector2i resolution) : Sampler(spp) {
+inline int countTrailingZeros(uint32_t v) {
+    int n = 0;
+    for (; !(v & 1); v >>= 1) n++;
+    return n;
+}
+
+SobolSampler::SobolSampler(uint32_t spp, Vector2i resolution, uint32_t seed) : Sampler(spp), m_seed(seed) {
     m_sobolIndex = 0;
+    m_sampleIndex = -2; // never continued by the first pixel sample
     m_dimension = 0;
     m_scale = roundUpPow2(std::max(resolution.x(), resolution.y()));
+    m_log2Scale = log2int(m_scale);
     m_pixel = Vector2i();
+    m_pixelHash = 0;
+    std::fill(m_values, m_values + CachedDimensions, 0u);
+    std::fill(m_seeds, m_seeds + CachedDimensions, 0u);
+
+    // the index is (frame << 2m) ^ f(frame) ^ g(pixel) with f, g linear,
+    // so flipping a frame bit changes it by the same column for every pixel
+    auto columns = std::make_shared<FrameColumns>();
+    columns->bits = std::min(MaxFrameBits, 64 - 2 * m_log2Scale);
+    for (int c = 0; c < columns->bits; c++) {
+        columns->index[c] = sobol::sobolIntervalToIndex(m_log2Scale, uint64_t(1) << c, Vector2i(0, 0));
+        for (int dim = 0; dim < CachedDimensions; dim++)
+            columns->values[c][dim] = sobol::sobolBits(columns->index[c], dim);
+    }
+    m_columns = std::move(columns);
 }
 
 void SobolSampler::startPixelSample(const Vector2i& p, int sampleIndex) {
-    m_pixel = p;
     m_dimension = 2;
-    m_sobolIndex = sobol::sobolIntervalToIndex(log2int(m_scale), sampleIndex, m_pixel);
+
+    // samples are visited in Gray-code order, the next one flips one frame bit
+    if (sampleIndex == m_sampleIndex + 1 && p == m_pixel) {
+        int bit = countTrailingZeros(uint32_t(sampleIndex));
+        if (bit < m_columns->bits) {
+            m_sampleIndex = sampleIndex;
+            m_sobolIndex ^= m_columns->index[bit];
+            const uint32_t* column = m_columns->values[bit];
+#if defined(__AVX2__)
+            for (int dim = 0; dim < CachedDimensions; dim += 8) {
+                __m256i v = _mm256_load_si256((const __m256i*) (m_values + dim));
+                __m256i c = _mm256_load_si256((const __m256i*) (column + dim));
+                _mm256_store_si256((__m256i*) (m_values + dim), _mm256_xor_si256(v, c));
+            }
+#elif defined(PT_SIMD_SSE)
+            for (int dim = 0; dim < CachedDimensions; dim += 4) {
+                __m128i v = _mm_load_si128((const __m128i*) (m_values + dim));
+                __m128i c = _mm_load_si128((const __m128i*) (column + dim));
+                _mm_store_si128((__m128i*) (m_values + dim), _mm_xor_si128(v, c));
+            }
+#else
+            for (int dim = 0; dim < CachedDimensions; dim++)
+                m_values[dim] ^= column[dim];
+#endif
+            return;
+        }
+    }
+
+    if (p != m_pixel || m_sampleIndex < 0) {
+        m_pixelHash = sobol::mixBits((uint64_t(uint32_t(p.x())) << 32 | uint32_t(p.y())) ^ sobol::mixBits(m_seed));
+        for (int dim = 2; dim < CachedDimensions; dim++)
+            m_seeds[dim] = dimensionSeed(dim);
+    }
+
+    m_pixel = p;
+    m_sampleIndex = sampleIndex;
+    uint64_t frame = uint32_t(sampleIndex) ^ (uint32_t(sampleIndex) >> 1);
+    m_sobolIndex = sobol::sobolIntervalToIndex(m_log2Scale, frame, m_pixel);
+    for (int dim = 0; dim < CachedDimensions; dim++)
+        m_values[dim] = sobol::sobolBits(m_sobolIndex, dim);
+}
+
+std::unique_ptr<Sampler> SobolSampler::clone() const {
+    return std::unique_ptr<Sampler>(new SobolSampler(*this));
+}
+
+
+ZSobolSampler::ZSobolSampler(uint32_t spp, Vector2i resolution, uint32_t seed) : Sampler(spp), m_seed(seed) {
+    // the index space is padded to a power of two when spp is not one
+    m_log2SPP = log2int(float(roundUpPow2(int32_t(spp))));
+    int res = roundUpPow2(std::max(resolution.x(), resolution.y()));
+    int log4SPP = (m_log2SPP + 1) / 2;
+    m_base4Digits = log2int(float(res)) + log4SPP;
+    m_mortonIndex = 0;
+    m_dimension = 0;
+}
+
+uint64_t ZSobolSampler::getSampleIndex() const {
+    static const uint8_t permutations[24][4] = {
+        {0, 1, 2, 3}, {0, 1, 3, 2}, {0, 2, 1, 3}, {0, 2, 3, 1},
+        {0, 3, 2, 1}, {0, 3, 1, 2}, {1, 0, 2, 3}, {1, 0, 3, 2},
+        {1, 2, 0, 3}, {1, 2, 3, 0}, {1, 3, 2, 0}, {1, 3, 0, 2},
+        {2, 1, 0, 3}, {2, 1, 3, 0}, {2, 0, 1, 3}, {2, 0, 3, 1},
+        {2, 3, 0, 1}, {2, 3, 1, 0}, {3, 1, 2, 0}, {3, 1, 0, 2},
+        {3, 2, 1, 0}, {3, 2, 0, 1}, {3, 0, 2, 1}, {3, 0, 1, 2}
+    };
+
+    uint64_t sampleIndex = 0;
+    // with an odd power of two spp the last digit is base 2
+    bool pow2Samples = m_log2SPP & 1;
+    int lastDigit = pow2Samples ? 1 : 0;
+    uint64_t dimensionHash = 0x55555555u * uint64_t(m_dimension);
+
+    for (int i = m_base4Digits - 1; i >= lastDigit; --i) {
+        int digitShift = 2 * i - (pow2Samples ? 1 : 0);
+        int digit = (m_mortonIndex >> digitShift) & 3;
+        uint64_t higherDigits = m_mortonIndex >> (digitShift + 2);
+        int p = (sobol::mixBits(higherDigits ^ dimensionHash) >> 24) % 24;
+        digit = permutations[p][digit];
+        sampleIndex |= uint64_t(digit) << digitShift;
+    }
+
+    if (pow2Samples) {
+        int digit = m_mortonIndex & 1;
+        sampleIndex |= digit ^ (sobol::mixBits((m_mortonIndex >> 1) ^ dimensionHash) & 1);
+    }
+
+    return sampleIndex;
 }
 
-inline float SobolSampler::sample1D() {
-    if (m_dimension >= sobol::NSobolDimensions)
-        m_dimension = 2;
-    return sampleDimension(m_dimension++);
+float ZSobolSampler::sample1D() {
+    uint64_t sampleIndex = getSampleIndex();
+    ++m_dimension;
+    uint32_t hash = uint32_t(sobol::mixBits(uint64_t(m_dimension) ^ (uint64_t(m_seed) << 32)));
+    return sobol::sobolToFloat(sobol::fastOwenScramble(sobol::sobolBits(sampleIndex, 0), hash));
 }
 
-inline Vector2f SobolSampler::sample2D() {
-    if (m_dimension + 1 >= sobol::NSobolDimensions)
-        m_dimension = 2;
-    Vector2f u(sampleDimension(m_dimension), sampleDimension(m_dimension + 1));
+Vector2f ZSobolSampler::sample2D() {
+    uint64_t sampleIndex = getSampleIndex();
     m_dimension += 2;
-    return u;
+    uint64_t hash = sobol::mixBits(uint64_t(m_dimension) ^ (uint64_t(m_seed) << 32));
+    return Vector2f(
+        sobol::sobolToFloat(sobol::fastOwenScramble(sobol::sobolBits(sampleIndex, 0), uint32_t(hash))),
+        sobol::sobolToFloat(sobol::fastOwenScramble(sobol::sobolBits(sampleIndex, 1), uint32_t(hash >> 32)))
+    );
 }
 
-inline Vector2f SobolSampler::samplePixel2D() {
-    Vector2f u(sampleDimension(0), sampleDimension(1));
-    // Remap Sobol\+$'$ dimensions used for pixel samples
-    for (int dim = 0; dim < 2; ++dim) {
-        u[dim] = std::clamp(u[dim] * m_scale - m_pixel[dim], 0.0f, sobol::FloatOneMinusEpsilon);
+
+void PhiloxSampler::generateBatch(int batch) {
+    constexpr int Blocks = BatchSize / 4;
+    uint32_t counter[4][Blocks], out[4][Blocks];
+    for (int lane = 0; lane < Blocks; lane++) {
+        counter[0][lane] = uint32_t(m_pixel.x());
+        counter[1][lane] = uint32_t(m_pixel.y());
+        counter[2][lane] = uint32_t(m_sampleIndex);
+        counter[3][lane] = uint32_t(batch * Blocks + lane);
     }
-    return u;
+    uint32_t key[2] = { m_seed, 0 };
+    philox::philox4x32x8(counter, key, out);
+
+    for (int lane = 0; lane < Blocks; lane++)
+        for (int i = 0; i < 4; i++)
+            m_values[4 * lane + i] = out[i][lane];
+    m_batch = batch;
 }
 
-std::unique_ptr<Sampler> SobolSampler::clone() const {
-    std::unique_ptr<SobolSampler> cloned(new SobolSampler(uint32_t(), Vector2i()));
-    cloned->m_spp = m_spp;
-    cloned->m_sobolIndex = m_sobolIndex;
-    cloned->m_dimension = m_dimension;
-    cloned->m_scale = m_scale;
-    cloned->m_pixel = m_pixel;
-    return std::move(cloned);
+float PhiloxSampler::sample(const Vector2i& p, int sampleIndex, int dimension, uint32_t seed) {
+    uint32_t counter[4] = { uint32_t(p.x()), uint32_t(p.y()), uint32_t(sampleIndex), uint32_t(dimension / 4) };
+    uint32_t key[2] = { seed, 0 };
+    uint32_t out[4];
+    philox::philox4x32(counter, key, out);
+    return philox::toUnitFloat(out[dimension % 4]);
 }
 
 }
\ No newline at end of file
@@ -2,7 +2,7 @@
 #include <pt/scene.h>
 #include <pt/color.h>
 #include <pt/mesh.h>
-#include <pt/bitmap.h>
+#include <pt/texture.h>
 #include <pt/material.h>
 #include <pt/camera.h>
 #include <pt/accel.h>
@@ -10,9 +10,12 @@
 #include <pt/shape.h>
 #include <pt/sampler.h>
 #include <pt/light.h>
+#include <pt/lightcache.h>
 #include <pt/filter.h>
 #include <pt/bvh.h>
 #include <pt/timer.h>
+#include <pt/stats.h>
+#include <pt/trace.h>
 
 #include <pugixml.hpp>
 #define TINYOBJLOADER_IMPLEMENTATION
@@ -20,7 +23,19 @@
 
 namespace pt {
 
+Scene::~Scene() {
+	delete m_accel;
+	delete m_camera;
+	delete m_filter;
+	delete m_filter_sampler;
+	delete m_light_selector; // complete type here, the selector has a virtual destructor
+	for (auto p : m_meshes) delete p;
+	for (auto p : m_materials) delete p;
+	for (auto p : m_shapes) delete p;
+}
+
 void Scene::loadOBJ(const std::string& filename) {
+	PT_TRACE_SCOPE("Parse OBJ", "scene");
 	cout << "Reading a OBJ file from \"" << filename << "\" .. ";
 	cout.flush();
 	Timer timer;
@@ -100,10 +115,8 @@ void Scene::loadOBJ(const std::string& filename) {
 			// find texture file under the same folder with OBJ file.
 			std::string baseDir = getFolderPath(filename);
 
-			// load bitmap data
-			Bitmap* bitmap = new Bitmap(material.diffuse_texname);
-			bitmap->load(baseDir + material.diffuse_texname);
-			material_->setTexture(bitmap);
+			// shared between materials, decoded in the background
+			material_->setTexture(m_textures.request(baseDir + material.diffuse_texname));
 		}
 
 		this->m_materials.push_back(material_);
@@ -114,6 +127,7 @@ void Scene::loadOBJ(const std::string& filename) {
 }
 
 void Scene::loadXML(const std::string& filename) {
+	PT_TRACE_SCOPE("Parse XML", "scene");
 	cout << "Reading a XML file from \"" << filename << "\" .. ";
 	cout.flush();
 	Timer timer;
@@ -210,13 +224,17 @@ bool Scene::rayIntersect(const Ray& ray, Intersection& its) const {
 	return m_accel->rayIntersect(ray, its);
 }
 
+PT_STAT_RATIO(statOccluded, "Scene", "Shadow rays occluded");
+
 bool Scene::unocculded(Vector3f p0, Vector3f p1, const Vector3f& n0, const Vector3f& n1) const {
 	p0 += n0 * Epsilon;
 	p1 += n1 * Epsilon;
 	Vector3f d = p1 - p0;
 	float dist = d.norm();
 	Ray ray(p0, d / dist, 0, dist * (1 - Epsilon));
-	return !m_accel->rayIntersect(ray);
+	bool occluded = m_accel->rayIntersect(ray);
+	PT_STAT_RATIO_ADD(statOccluded, occluded ? 1 : 0, 1);
+	return !occluded;
 }
 
 void Scene::preprocess() {
@@ -228,10 +246,26 @@ void Scene::preprocess() {
 	cout << "Building BVH tree for accelration ...";
 	cout.flush();
 	Timer timer;
-	m_accel = new BVHTree(&m_shapes);
-	m_accel->build();
+	{
+		PT_TRACE_SCOPE("Build BVH", "scene");
+		m_accel = new BVHTree(&m_shapes);
+		m_accel->build();
+	}
 	cout << "done. (took " << timer.elapsedString() << ")" << endl;
 
+	// textures are decoded while meshes and BVH are processed
+	cout << "Waiting for " << m_textures.getTextureCount() << " textures ...";
+	cout.flush();
+	timer.reset();
+	{
+		PT_TRACE_SCOPE("Wait for textures", "scene");
+		m_textures.wait();
+	}
+	cout << "done. (took " << timer.elapsedString() << ")" << endl;
+
+	// classify materials for shading
+	m_material_table.build(m_materials);
+
 	// create filter
 	m_filter = new GaussianFilter();
 }
@@ -242,7 +276,8 @@ void Scene::createPrimitives() {
 		total_triangles += m_meshes[i]->getTriangleCount();
 		for (uint32_t j = 0; j < m_meshes[i]->getTriangleCount(); j++) {
 			uint32_t mtl_id = m_meshes[i]->getMaterialId(j);
-			m_shapes.push_back(new Triangle(j, m_meshes[i], m_materials[mtl_id]));
+			m_shapes.push_back(new Triangle(j, m_meshes[i], m_materials[mtl_id], mtl_id));
+			m_bounds += m_shapes.back()->getAABB();
 		}
 	}
 	//cout << "Create " << total_triangles << " primitives!" << endl;
@@ -252,7 +287,7 @@ void Scene::createAreaLights() {
 	for (LightInfo& info : m_light_infos) {
 		for (Triangle* shape : m_shapes) {
 			if (shape->getMaterial()->getName() == info.mtl_name) {
-				AreaLight* light = new AreaLight(shape, info.radiance);
+				AreaLight* light = new AreaLight(shape, info.radiance, uint32_t(m_lights.size()));
 				m_lights.push_back(light);
 				shape->setLight(light);
 			}
@@ -262,6 +297,19 @@ void Scene::createAreaLights() {
 	//cout << "Create " << m_lights.size() << " area lights!" << endl;
 }
 
+const FilterSampler* Scene::enableFilterSampling() {
+	if (!m_filter_sampler)
+		m_filter_sampler = new FilterSampler(m_filter);
+	return m_filter_sampler;
+}
+
+LightCacheSelector* Scene::enableLightCache() {
+	LightCacheSelector* selector = new LightCacheSelector(&m_lights, m_bounds);
+	delete m_light_selector;
+	m_light_selector = selector;
+	return selector;
+}
+
 std::string Scene::toString() const {
 	std::string meshes_str, materials_str;
 	for (size_t i = 0; i < m_meshes.size(); ++i) {
@@ -282,6 +330,8 @@ std::string Scene::toString() const {
 		"  num_shapes = %i,\n"
 		"  num_lights = %i,\n"
 		"  light_selector = %s,\n"
+		"  textures = %s,\n"
+		"  material_table = %s,\n"
 		"  camera = %s,\n"
 		"  accel = %s,\n"
 		"  filter = %s,\n"
@@ -293,6 +343,8 @@ std::string Scene::toString() const {
 		m_shapes.size(),
 		m_lights.size(),
 		indent(m_light_selector->toString()),
+		indent(m_textures.toString()),
+		indent(m_material_table.toString()),
 		indent(m_camera->toString()),
 		indent(m_accel->toString()),
 		indent(m_filter->toString()),
@@ -2,6 +2,7 @@
 #include <pt/mesh.h>
 #include <pt/aabb.h>
 #include <pt/ray.h>
+#include <pt/vec.h>
 #include <pt/light.h>
 #include <pt/material.h>
 #include <pt/ray.h>
@@ -23,12 +24,6 @@ bool Triangle::getUV(Vector2f& uv0, Vector2f& uv1, Vector2f& uv2) const {
 	return mesh->getUV(m_triangle_id, uv0, uv1, uv2);
 }
 
-//uint32_t Triangle::getMaterialId() const {
-//	TriangleMesh* mesh = getMesh();
-//	return mesh->getMaterialId(m_triangle_id);
-//}
-
-
 float Triangle::surfaceArea() const {
 	Vector3f v0, v1, v2;
 	getVertex(v0, v1, v2);
@@ -48,40 +43,41 @@ Vector3f Triangle::getCenter() const {
 }
 
 bool Triangle::intersect(const Ray& ray, Vector3f& bary, float& t) const {
-	Vector3f p0, p1, p2;
-	getVertex(p0, p1, p2);
+	Vector3f v0, v1, v2;
+	getVertex(v0, v1, v2);
+	Vec3 p0(v0), dir(ray.dir);
 
 	/* Find vectors for two edges sharing v[0] */
-	Vector3f edge1 = p1 - p0, edge2 = p2 - p0;
+	Vec3 edge1 = Vec3(v1) - p0, edge2 = Vec3(v2) - p0;
 
 	/* Begin calculating determinant - also used to calculate U parameter */
-	Vector3f pvec = ray.dir.cross(edge2);
+	Vec3 pvec = cross(dir, edge2);
 
 	/* If determinant is near zero, ray lies in plane of triangle */
-	float det = edge1.dot(pvec);
+	float det = dot(edge1, pvec);
 	if (det > -1e-5f && det < 1e-5f)
 		return false;
 
 	float inv_det = 1.0f / det;
 
 	/* Calculate distance from v[0] to ray origin */
-	Vector3f tvec = ray.org - p0;
+	Vec3 tvec = Vec3(ray.org) - p0;
 
 	/* Calculate U parameter and test bounds */
-	float u = tvec.dot(pvec) * inv_det;
+	float u = dot(tvec, pvec) * inv_det;
 	if (u < 0.0 || u > 1.0)
 		return false;
 
 	/* Prepare to test V parameter */
-	Vector3f qvec = tvec.cross(edge1);
+	Vec3 qvec = cross(tvec, edge1);
 
 	/* Calculate V parameter and test bounds */
-	float v = ray.dir.dot(qvec) * inv_det;
+	float v = dot(dir, qvec) * inv_det;
 	if (v < 0.0 || u + v > 1.0)
 		return false;
 
 	/* Ray intersects triangle -> compute t */
-	t = edge2.dot(qvec) * inv_det;
+	t = dot(edge2, qvec) * inv_det;
 
 	bary << 1 - u - v, u, v;
 
@@ -132,6 +128,8 @@ Intersection& Intersection::operator= (const Intersection& cls) {
 	ng = cls.ng;
 	uv = cls.uv;
 	ts = cls.ts;
+	dudx = cls.dudx; dvdx = cls.dvdx;
+	dudy = cls.dudy; dvdy = cls.dvdy;
 	m_shape = cls.m_shape;
 	m_bary = cls.m_bary;
 	return *this;
@@ -163,6 +161,54 @@ void Intersection::complete() {
 	Vector2f uv0(0.0f, 0.0f), uv1(1.0f, 0.0f), uv2(1.0f, 1.0f);
 	m_shape->getUV(uv0, uv1, uv2); // rewrite if shape has uv
 	uv = uv0 * m_bary.x() + uv1 * m_bary.y() + uv2 * m_bary.z();
+
+	dudx = dvdx = dudy = dvdy = 0.0f;
+}
+
+void Intersection::computeDifferentials(const RayDifferential& ray) {
+	/**
+	* Igehy, H. (1999). Tracing ray differentials. SIGGRAPH '99.
+	* Pharr, M., Jakob, W., Humphreys, G. Physically Based Rendering, 3rd ed., chapter 10.1.
+	*/
+	dudx = dvdx = dudy = dvdy = 0.0f;
+	if (!ray.hasDifferentials || !m_shape) return;
+
+	Vector2f uv0, uv1, uv2;
+	if (!m_shape->getUV(uv0, uv1, uv2)) return;
+
+	// intersect offset rays with the tangent plane at p
+	float d = ng.dot(p);
+	float tx = (d - ng.dot(ray.rxOrg)) / ng.dot(ray.rxDir);
+	float ty = (d - ng.dot(ray.ryOrg)) / ng.dot(ray.ryDir);
+	if (!std::isfinite(tx) || !std::isfinite(ty)) return;
+	Vector3f dpdx = ray.rxOrg + tx * ray.rxDir - p;
+	Vector3f dpdy = ray.ryOrg + ty * ray.ryDir - p;
+
+	// dp/du and dp/dv of the triangle parameterization
+	Vector3f v0, v1, v2;
+	m_shape->getVertex(v0, v1, v2);
+	Vector2f duv02 = uv0 - uv2, duv12 = uv1 - uv2;
+	Vector3f dp02 = v0 - v2, dp12 = v1 - v2;
+	float det = duv02.x() * duv12.y() - duv02.y() * duv12.x();
+	if (std::abs(det) < 1e-12f) return;
+	float invDet = 1.0f / det;
+	Vector3f dpdu = (duv12.y() * dp02 - duv02.y() * dp12) * invDet;
+	Vector3f dpdv = (duv02.x() * dp12 - duv12.x() * dp02) * invDet;
+
+	// least squares solution of dp = dpdu * du + dpdv * dv
+	float a00 = dpdu.dot(dpdu), a01 = dpdu.dot(dpdv), a11 = dpdv.dot(dpdv);
+	float invDetA = a00 * a11 - a01 * a01;
+	if (std::abs(invDetA) < 1e-20f) return;
+	invDetA = 1.0f / invDetA;
+
+	float bx0 = dpdu.dot(dpdx), bx1 = dpdv.dot(dpdx);
+	float by0 = dpdu.dot(dpdy), by1 = dpdv.dot(dpdy);
+	dudx = (a11 * bx0 - a01 * bx1) * invDetA;
+	dvdx = (a00 * bx1 - a01 * bx0) * invDetA;
+	dudy = (a11 * by0 - a01 * by1) * invDetA;
+	dvdy = (a00 * by1 - a01 * by0) * invDetA;
+	if (!std::isfinite(dudx) || !std::isfinite(dvdx) || !std::isfinite(dudy) || !std::isfinite(dvdy))
+		dudx = dvdx = dudy = dvdy = 0.0f;
 }
 	
 Vector3f Intersection::Le(const Vector3f& w) const {
@@ -0,0 +1,128 @@
+#include <pt/stats.h>
+
+#if defined(PT_ENABLE_STATS)
+
+#include <mutex>
+#include <map>
+
+namespace pt {
+namespace stats {
+
+namespace {
+
+struct StatInfo {
+    std::string category, name;
+    Kind kind;
+};
+
+// created on first use so that Stat objects of other files can register during static
+// initialization, and never destroyed since worker threads may exit after static destructors ran
+struct Registry {
+    std::mutex mutex;
+    std::vector<StatInfo> stats;
+    std::vector<ThreadStats*> threads;
+    Slot retired[MaxStats]; // totals of the threads that already exited
+};
+
+Registry& registry() {
+    static Registry* registry = new Registry();
+    return *registry;
+}
+
+}
+
+void Slot::merge(const Slot& other) {
+    count += other.count;
+    total += other.total;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    for (int i = 0; i < HistogramBins; ++i)
+        bins[i] += other.bins[i];
+}
+
+ThreadStats::ThreadStats() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.push_back(this);
+}
+
+ThreadStats::~ThreadStats() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (int i = 0; i < MaxStats; ++i)
+        r.retired[i].merge(slots[i]);
+    r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+}
+
+Stat::Stat(const char* category, const char* name, Kind kind) : m_histogram(kind == Kind::Histogram) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.stats.size() >= MaxStats)
+        throw PathTracerException("Too many statistics, increase stats::MaxStats!");
+    m_id = int(r.stats.size());
+    r.stats.push_back(StatInfo{ category, name, kind });
+}
+
+void print(std::ostream& os) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    // category -> lines, sorted by category and then by name
+    std::map<std::string, std::map<std::string, std::string>> lines;
+    for (size_t id = 0; id < r.stats.size(); ++id) {
+        const StatInfo& info = r.stats[id];
+        Slot sum = r.retired[id];
+        for (const ThreadStats* thread : r.threads)
+            sum.merge(thread->slots[id]);
+
+        std::string line;
+        switch (info.kind) {
+            case Kind::Counter:
+                line = tfm::format("%12i", sum.count);
+                break;
+            case Kind::Ratio:
+                line = tfm::format("%12i / %i (%.2f%%)", sum.count, sum.total,
+                    sum.total > 0 ? 100.0 * sum.count / sum.total : 0.0);
+                break;
+            case Kind::Distribution:
+            case Kind::Histogram:
+                if (sum.count == 0) {
+                    line = tfm::format("%12s", "no samples");
+                    break;
+                }
+                line = tfm::format("%12.3f avg [range %i - %i, %i samples]",
+                    double(sum.total) / sum.count, sum.min, sum.max, sum.count);
+                if (info.kind == Kind::Histogram) {
+                    for (int i = 0; i < HistogramBins; ++i) {
+                        if (sum.bins[i] == 0) continue;
+                        line += tfm::format("\n      %3i%s %10i (%5.2f%%)", i, i == HistogramBins - 1 ? "+" : " ",
+                            sum.bins[i], 100.0 * sum.bins[i] / sum.count);
+                    }
+                }
+                break;
+        }
+        lines[info.category][info.name] = line;
+    }
+
+    os << "Statistics:" << std::endl;
+    for (const auto& category : lines) {
+        os << "  " << category.first << std::endl;
+        for (const auto& stat : category.second)
+            os << tfm::format("    %-40s%s", stat.first, stat.second) << std::endl;
+    }
+}
+
+void clear() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (int i = 0; i < MaxStats; ++i) {
+        r.retired[i] = Slot();
+        for (ThreadStats* thread : r.threads)
+            thread->slots[i] = Slot();
+    }
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,208 @@
+#include <pt/texture.h>
+#include <pt/trace.h>
+
+// STB_IMAGE_IMPLEMENTATION is already been define in an external project.
+#include <stb_image.h>
+#include <filesystem/path.h>
+#include <memory>
+
+namespace pt {
+
+/// sRGB 8-bit -> linear float
+struct SRGBTable {
+    float values[256];
+
+    SRGBTable() {
+        for (int i = 0; i < 256; i++)
+            values[i] = Color3f(i / 255.0f).toLinearRGB().x();
+    }
+};
+
+static const SRGBTable srgbTable;
+
+inline uint8_t encodeSRGB(float value) {
+    value = Color3f(value).toSRGB().x();
+    return (uint8_t) std::clamp(255.f * value + 0.5f, 0.f, 255.f);
+}
+
+void Texture::Level::resize(int w, int h) {
+    width = w;
+    height = h;
+    tilesX = (w + TileSize - 1) / TileSize;
+    int tilesY = (h + TileSize - 1) / TileSize;
+    tiles.assign(size_t(tilesX) * tilesY, Tile());
+}
+
+void Texture::load(const std::string& filename, Layout layout) {
+    int width, height, channel;
+    std::unique_ptr<uint8_t, decltype(&stbi_image_free)> rgb8(
+        stbi_load(filename.c_str(), &width, &height, &channel, 3), &stbi_image_free);
+
+    if (rgb8 == nullptr)
+        throw PathTracerException(("Fail to load image file: \"" + filename + "\"!").c_str());
+
+    setData(width, height, rgb8.get(), layout);
+}
+
+void Texture::setData(int width, int height, const uint8_t* rgb8, Layout layout) {
+    if (width <= 0 || height <= 0)
+        throw PathTracerException("Invalid texture size!");
+
+    m_layout = layout;
+    m_levels.clear();
+    m_levels.emplace_back();
+    Level& level = m_levels.back();
+    level.resize(width, height);
+
+    auto fill = [&](auto tag) {
+        constexpr Layout L = decltype(tag)::value;
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const uint8_t* in = rgb8 + 3 * (size_t(y) * width + x);
+                uint8_t* out = level.texel<L>(x, y);
+                out[0] = in[0]; out[1] = in[1]; out[2] = in[2]; out[3] = 255;
+            }
+        }
+        buildPyramid<L>();
+    };
+
+    if (layout == Layout::Tiled)
+        fill(std::integral_constant<Layout, Layout::Tiled>());
+    else
+        fill(std::integral_constant<Layout, Layout::RowMajor>());
+}
+
+template <Texture::Layout L>
+void Texture::buildPyramid() {
+    while (m_levels.back().width > 1 || m_levels.back().height > 1) {
+        Level dst;
+        {
+            const Level& src = m_levels.back();
+            dst.resize(std::max(src.width / 2, 1), std::max(src.height / 2, 1));
+
+            // 2x2 box filter in linear space, odd borders are clamped
+            for (int y = 0; y < dst.height; ++y) {
+                int y0 = std::min(2 * y, src.height - 1), y1 = std::min(2 * y + 1, src.height - 1);
+                for (int x = 0; x < dst.width; ++x) {
+                    int x0 = std::min(2 * x, src.width - 1), x1 = std::min(2 * x + 1, src.width - 1);
+                    const uint8_t* t00 = src.texel<L>(x0, y0), * t01 = src.texel<L>(x1, y0);
+                    const uint8_t* t10 = src.texel<L>(x0, y1), * t11 = src.texel<L>(x1, y1);
+                    uint8_t* out = dst.texel<L>(x, y);
+                    for (int c = 0; c < 3; c++) {
+                        float sum = srgbTable.values[t00[c]] + srgbTable.values[t01[c]] +
+                            srgbTable.values[t10[c]] + srgbTable.values[t11[c]];
+                        out[c] = encodeSRGB(0.25f * sum);
+                    }
+                    out[3] = 255;
+                }
+            }
+        }
+        m_levels.push_back(std::move(dst));
+    }
+}
+
+size_t Texture::getMemorySize() const {
+    size_t bytes = 0;
+    for (const Level& level : m_levels)
+        bytes += level.tiles.size() * sizeof(Tile);
+    return bytes;
+}
+
+template <Texture::Layout L>
+Color3f Texture::sampleLevel(int l, const Vector2f& uv) const {
+    const Level& level = m_levels[l];
+
+    // bilinear interpolation (in linear space)
+    float u = std::clamp(uv.x(), 0.0f, 1.0f);
+    float v = std::clamp(uv.y(), 0.0f, 1.0f);
+    float s = std::max(u * level.width - 0.5f, 0.0f);
+    float t = std::max(v * level.height - 0.5f, 0.0f);
+    int x0 = std::min(int(s), level.width - 1);
+    int y0 = std::min(int(t), level.height - 1);
+    int x1 = std::min(x0 + 1, level.width - 1);
+    int y1 = std::min(y0 + 1, level.height - 1);
+    float alpha = s - x0;
+    float beta = t - y0;
+
+    const uint8_t* t00 = level.texel<L>(x0, y0), * t01 = level.texel<L>(x1, y0);
+    const uint8_t* t10 = level.texel<L>(x0, y1), * t11 = level.texel<L>(x1, y1);
+    const float* lut = srgbTable.values;
+    Color3f result;
+    for (int c = 0; c < 3; c++) {
+        float a = mix(lut[t00[c]], lut[t01[c]], alpha);
+        float b = mix(lut[t10[c]], lut[t11[c]], alpha);
+        result[c] = mix(a, b, beta);
+    }
+    return result;
+}
+
+Color3f Texture::sample(const Vector2f& uv) const {
+    return sampleLevel(0, uv);
+}
+
+Color3f Texture::sample(const Vector2f& uv, float width) const {
+    // footprint in texels of the finest level
+    Vector2i size = getSize();
+    float texels = width * std::max(size.x(), size.y());
+    if (!(texels > 1.0f))
+        return sampleLevel(0, uv);
+
+    float level = std::min(std::log2(texels), float(m_levels.size() - 1));
+    int l0 = int(level);
+    if (l0 >= int(m_levels.size()) - 1)
+        return sampleLevel(int(m_levels.size()) - 1, uv);
+
+    float t = level - l0;
+    return mix(sampleLevel(l0, uv), sampleLevel(l0 + 1, uv), t);
+}
+
+TextureManager::~TextureManager() {
+    // tasks still hold raw pointers to the textures
+    try {
+        m_tasks.wait();
+    }
+    catch (...) { } // already reported by wait() or superseded by another error
+}
+
+std::shared_ptr<Texture> TextureManager::request(const std::string& filename) {
+    std::string key = filename;
+    try {
+        key = filesystem::path(filename).make_absolute().str();
+    }
+    catch (const std::runtime_error&) { } // missing file, reported by load()
+
+    auto it = m_textures.find(key);
+    if (it != m_textures.end())
+        return it->second;
+
+    auto texture = std::make_shared<Texture>(filesystem::path(filename).filename());
+    m_textures.emplace(key, texture);
+
+    Texture* target = texture.get();
+    m_tasks.run([target, filename] {
+        PT_TRACE_SCOPE("Decode texture", "scene");
+        target->load(filename);
+    });
+    return texture;
+}
+
+void TextureManager::wait() {
+    // rethrows the exception of a failed decode
+    m_tasks.wait();
+}
+
+std::string TextureManager::toString() const {
+    size_t bytes = 0;
+    for (const auto& item : m_textures)
+        bytes += item.second->getMemorySize();
+
+    return tfm::format(
+        "TextureManager[\n"
+        "  textures = %i,\n"
+        "  memory = %i KB\n"
+        "]",
+        m_textures.size(), bytes / 1024
+    );
+}
+
+}
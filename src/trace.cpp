@@ -0,0 +1,106 @@
+#include <pt/trace.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <atomic>
+#include <fstream>
+
+namespace pt {
+namespace trace {
+
+namespace {
+
+struct Event {
+    std::string name, args;
+    const char* category;
+    int64_t begin, duration; // microseconds since start()
+};
+
+struct ThreadEvents {
+    int id = -1;
+    std::vector<Event> events;
+};
+
+std::atomic<bool> enabled{ false };
+std::string outputPath;
+std::chrono::steady_clock::time_point origin;
+std::atomic<int> threadCount{ 0 };
+tbb::enumerable_thread_specific<ThreadEvents> threadEvents;
+
+int64_t microseconds(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(t - origin).count();
+}
+
+std::string escape(const std::string& s) {
+    std::string result;
+    for (char c : s) {
+        if (c == '"' || c == '\\') result += '\\';
+        if (c == '\n') { result += "\\n"; continue; }
+        result += c;
+    }
+    return result;
+}
+
+}
+
+void start(const std::string& filename) {
+    outputPath = filename;
+    origin = std::chrono::steady_clock::now();
+    threadEvents.clear();
+    threadCount = 0;
+    enabled = true;
+}
+
+bool isEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void Scope::begin(const char* name, const char* category, const std::string& args) {
+    m_active = true;
+    m_name = name;
+    m_category = category;
+    m_args = args;
+    m_start = std::chrono::steady_clock::now();
+}
+
+void Scope::end() {
+    auto now = std::chrono::steady_clock::now();
+    ThreadEvents& local = threadEvents.local();
+    if (local.id < 0) local.id = threadCount++;
+    local.events.push_back(Event{ std::move(m_name), std::move(m_args), m_category,
+        microseconds(m_start), microseconds(now) - microseconds(m_start) });
+}
+
+void stop() {
+    if (!enabled) return;
+    enabled = false;
+
+    size_t count = 0;
+    for (const ThreadEvents& thread : threadEvents)
+        count += thread.events.size();
+    cout << "Writing " << count << " trace events to \"" << outputPath << "\"" << endl;
+
+    std::ofstream file(outputPath);
+    if (!file) {
+        cout << "trace::stop(): Could not save trace file \"" << outputPath << "\"" << endl;
+        return;
+    }
+
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for (const ThreadEvents& thread : threadEvents) {
+        if (thread.id < 0) continue;
+        file << (first ? "" : ",\n") << tfm::format(
+            "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %i, \"args\": {\"name\": \"thread %i\"}}",
+            thread.id, thread.id);
+        first = false;
+
+        for (const Event& e : thread.events) {
+            file << ",\n" << tfm::format(
+                "{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %i, \"dur\": %i, \"pid\": 1, \"tid\": %i, \"args\": {%s}}",
+                escape(e.name), e.category, e.begin, e.duration, thread.id, e.args);
+        }
+    }
+    file << "\n]}\n";
+}
+
+}
+}